@@ -19,23 +19,52 @@
 
 #pragma once
 
+#include <atomic>
+#include <memory>
 #include <thread>
+#include <vector>
 
 #include <boost/asio/io_context.hpp>
 #include <boost/log/trivial.hpp>
 
 /************************************************************************/
 /*
- * This is the thread that handles all asio-related stuff
+ * These are the threads that handle all asio-related stuff.
+ *
+ * There are a number of "shards", each with its own io_context and
+ * thread. Shard 0 is the "main" Asio thread; the process-wide state
+ * like the rate limiting, the CM list or the signal handling lives
+ * there, and getIoContext()/post()/isThread() without a shard still
+ * refer to it.
+ *
+ * Anything that wants to spread out picks a shard with pickShard(),
+ * and then does all its work on that shard. Steam connections and
+ * the actual HTTP queries do that.
+ *
+ * The number of shards defaults to the number of cores; use
+ * setThreadCount() before the first use to change it.
+ *
+ * Host names are resolved through Asio::Resolver (see
+ * Asio/Resolver.hpp), which caches the results.
  */
 
 namespace SteamBot
 {
     class Asio
     {
+    public:
+        typedef size_t Shard;
+        static constexpr Shard mainShard=0;
+
     private:
-        std::thread thread;
-        std::shared_ptr<boost::asio::io_context> ioContext;
+        class Thread;
+
+    public:
+        class Resolver;
+
+    private:
+        std::vector<std::unique_ptr<Thread>> threads;
+        std::atomic<Shard> nextShard{0};
 
     private:
         Asio();
@@ -44,20 +73,29 @@ namespace SteamBot
         static Asio& get();
 
     public:
-        static bool isThread();
+        static void setThreadCount(unsigned int);
+
+        static Shard pickShard();
 
-        static boost::asio::io_context& getIoContext();
+        static bool isThread(Shard=mainShard);
+
+        static boost::asio::io_context& getIoContext(Shard=mainShard);
 
     public:
-        template <typename HANDLER> static void post(std::string_view name, HANDLER handler)
+        template <typename HANDLER> static void post(Shard shard, std::string_view name, HANDLER handler)
         {
             bool noLogging=(name=="Connections::writePacket");
-            if (!noLogging) BOOST_LOG_TRIVIAL(debug) << "Asio: posting \"" << name << "\"";
-            getIoContext().post([name, noLogging, handler=std::move(handler)]() mutable {
+            if (!noLogging) BOOST_LOG_TRIVIAL(debug) << "Asio: posting \"" << name << "\" to shard " << shard;
+            getIoContext(shard).post([name, noLogging, handler=std::move(handler)]() mutable {
                 if (!noLogging) BOOST_LOG_TRIVIAL(debug) << "Asio: thread is running \"" << name << "\"";
                 handler();
                 if (!noLogging) BOOST_LOG_TRIVIAL(debug) << "Asio: thread is exiting \"" << name << "\"";
             });
         }
+
+        template <typename HANDLER> static void post(std::string_view name, HANDLER handler)
+        {
+            post(mainShard, name, std::move(handler));
+        }
     };
 }
@@ -20,10 +20,13 @@
 #pragma once
 
 #include "Client/ResultWaiter.hpp"
+#include "Asio/Asio.hpp"
 #include "Connection/Encrypted.hpp"
+#include "Client/Deadline.hpp"
 
 #include <memory>
 #include <queue>
+#include <atomic>
 
 /************************************************************************/
 
@@ -41,7 +44,9 @@ namespace SteamBot
 /************************************************************************/
 /*
  * This manages all client connections.
- * It runs on the Asio thread.
+ *
+ * Each connection is assigned to one of the Asio shards, and all its
+ * fibers and socket operations run on that shard's thread.
  */
 
 namespace SteamBot
@@ -54,6 +59,22 @@ namespace SteamBot
     public:
         typedef std::shared_ptr<Connection> ConnectResult;
 
+    public:
+        class WriteStatistics
+        {
+        public:
+            uint64_t batches=0;
+            uint64_t packets=0;
+            uint64_t largestBatch=0;
+        };
+
+    private:
+        std::atomic<size_t> maxWriteBatch{64};
+        std::atomic<uint64_t> writeBatches{0};
+        std::atomic<uint64_t> writtenPackets{0};
+        std::atomic<uint64_t> largestWriteBatch{0};
+        std::atomic<std::chrono::steady_clock::duration> connectTimeout{std::chrono::minutes(1)};
+
     private:
         Connections();
         ~Connections() =delete;
@@ -63,10 +84,19 @@ namespace SteamBot
         static bool readPacket(ConnectResult::weak_type);
         static void run(ConnectResult::weak_type);
         static bool makeConnection(const SteamBot::Connection::Endpoint&, Connections::ConnectResult&);
-        static void fetchEndpointsAndMakeConnection(Connections::ConnectResult);
+        static void fetchEndpointsAndMakeConnection(Connections::ConnectResult, SteamBot::Deadline);
 
     public:
         static ConnectResult connect(std::shared_ptr<SteamBot::WaiterBase>);
+
+    public:
+        // Queued packets are written in batches of up to this many packets
+        static void setMaxWriteBatch(size_t);
+        static WriteStatistics getWriteStatistics();
+
+        // If we can't connect within this time, the connection
+        // goes into Error status
+        static void setConnectTimeout(std::chrono::steady_clock::duration);
     };
 }
 
@@ -92,19 +122,20 @@ public:
 
 private:
     std::weak_ptr<Connection> self;
+    const SteamBot::Asio::Shard shard;
 
 private:
-    // This is owned by the asio-thread
+    // This is owned by the asio-thread of our shard
     std::shared_ptr<SteamBot::Connection::Encrypted> connection;
-    bool writingPackets=false;
 
 private:
     // Get the mutex before using this
     mutable boost::fibers::mutex mutex;
     Status status=Status::Connecting;
-    std::queue<std::vector<std::byte>> readPackets;
+    std::queue<SteamBot::Connection::PacketBuffer> readPackets;
     bool statusChanged=true;
     std::queue<std::vector<std::byte>> writePackets;
+    bool writeScheduled=false;
     SteamBot::Connection::Endpoint localEndpoint;
     SteamBot::Connection::Endpoint remoteEndpoint;
 
@@ -128,7 +159,7 @@ public:
 public:
     Status peekStatus() const;
     Status getStatus();						// this will reset the changed status
-    std::vector<std::byte> readPacket();	// empty when there's none
+    SteamBot::Connection::PacketBuffer readPacket();	// empty when there's none
     decltype(localEndpoint) getLocalEndpoint() const;
 
     void writePacket(std::vector<std::byte>);
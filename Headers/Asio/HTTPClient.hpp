@@ -29,12 +29,15 @@
 #include <boost/json/value.hpp>
 
 #include "Client/ResultWaiter.hpp"
+#include "Client/Deadline.hpp"
 #include "Web/CookieJar.hpp"
 
 /************************************************************************/
 
 namespace SteamBot
 {
+    class ClientInfo;
+
     namespace HTTPClient
     {
         class RateLimitQueue;
@@ -58,11 +61,40 @@ namespace SteamBot
             boost::urls::url url;
             boost::beast::http::request<boost::beast::http::string_body> request;
 
+            // perform() combines this with the caller's deadline. If
+            // the query can't finish in time, it fails with a
+            // boost::beast::error::timeout error.
+            SteamBot::Deadline deadline;
+
+            // The RateLimitQueue starts queries with a better priority
+            // first. Bulk queries that have been waiting for a while
+            // are promoted, so they don't get stuck behind a steady
+            // stream of more important ones.
+            enum class Priority { TimeSensitive, Interactive, Bulk };
+            Priority priority=Priority::Interactive;
+
+            // The account that makes the query; the RateLimitQueue
+            // shares its slots fairly between accounts. Filled in
+            // from the current client if you don't set it.
+            const SteamBot::ClientInfo* clientInfo=nullptr;
+
+            // The RateLimitQueue has a token bucket for each host and
+            // endpoint class. If this is empty, the first segment of
+            // the path is used, such as "market" or "IEconService".
+            std::string endpointClass;
+
+            // Set this to parse a 200 response as JSON while it is
+            // being received; use parseJson() to get the result. The
+            // value is allocated from a monotonic resource sized for
+            // the response, and the body isn't kept in "response".
+            bool streamJson=false;
+
         public:
             // this gets filled in during perform(). Check the error first.
             boost::system::error_code error;
             boost::beast::flat_buffer responseBuffer;
             boost::beast::http::response<boost::beast::http::dynamic_body> response;
+            boost::json::value json;
 
         public:
             Query(boost::beast::http::verb, boost::urls::url);
@@ -80,6 +112,9 @@ namespace SteamBot
  * This is a blocking call.
  * It will cancel.
  * Can also set and update cookies.
+ *
+ * Throws a TimeoutException if the deadline expires before we get
+ * a response.
  */
 
 namespace SteamBot
@@ -90,10 +125,89 @@ namespace SteamBot
     }
 }
 
+/************************************************************************/
+/*
+ * Connections to web servers are kept open after a query, so the
+ * next query to the same host doesn't need another DNS lookup, TCP
+ * connect and TLS handshake.
+ *
+ * Idle connections are closed after the idle timeout, or when the
+ * server closes them. There are at most "maxPerHost" idle
+ * connections to each host, and "maxTotal" overall.
+ *
+ * If a query fails on a connection from the pool before we got a
+ * response, it is retried once on a new connection.
+ */
+
+namespace SteamBot
+{
+    namespace HTTPClient
+    {
+        class ConnectionPool
+        {
+        public:
+            class Statistics
+            {
+            public:
+                uint64_t created=0;
+                uint64_t reused=0;
+                uint64_t stale=0;
+                uint64_t idle=0;
+            };
+
+        public:
+            // Call these before making queries
+            static void setMaxPerHost(size_t);
+            static void setMaxTotal(size_t);
+            static void setIdleTimeout(std::chrono::steady_clock::duration);
+
+            static Statistics getStatistics();
+            static void logStatistics();
+        };
+    }
+}
+
+/************************************************************************/
+/*
+ * New connections negotiate TLS 1.3 if the server supports it (but
+ * at least TLS 1.2), and try to resume a TLS session we got from the
+ * same host before. A resumed handshake skips the certificate
+ * exchange and verification.
+ *
+ * We keep the most recent session of each host; TLS 1.3 tickets are
+ * only used once.
+ */
+
+namespace SteamBot
+{
+    namespace HTTPClient
+    {
+        class TLSSessionCache
+        {
+        public:
+            class Statistics
+            {
+            public:
+                uint64_t fullHandshakes=0;
+                uint64_t resumedHandshakes=0;
+                uint64_t sessions=0;
+            };
+
+        public:
+            static Statistics getStatistics();
+            static void logStatistics();
+        };
+    }
+}
+
 /************************************************************************/
 /*
  * Given a response from an HTTPCliebnt query, return the body as
  * "something useful".
+ *
+ * For "streamJson" queries, parseJson() returns the value that was
+ * parsed while receiving; the non-const version moves it out of the
+ * query instead of copying it.
  */
 
 namespace SteamBot
@@ -101,6 +215,7 @@ namespace SteamBot
     namespace HTTPClient
     {
         boost::json::value parseJson(const Query&);
+        boost::json::value parseJson(Query&);
         std::string parseString(const Query&);
     }
 }
@@ -21,7 +21,10 @@
 
 #include "Asio/HTTPClient.hpp"
 
-#include <queue>
+#include <list>
+#include <map>
+#include <unordered_map>
+#include <unordered_set>
 
 #include <boost/asio/steady_timer.hpp>
 
@@ -31,6 +34,37 @@
  * HTPPClient::Query on it, and they will be executed on the Asio
  * thread when their slot comes up.
  *
+ * Each host and endpoint class (see Query::endpointClass) has its
+ * own token bucket: a query needs a token, and tokens come back at
+ * one per "schedule", up to "burst" tokens. So queries to different
+ * endpoints don't wait for each other, and an endpoint that has been
+ * idle can take a short burst. At most "concurrency"
+ * queries of the queue are running at the same time.
+ *
+ * If a server responds with 429 (Too Many Requests) or 503 (Service
+ * Unavailable), we stop sending queries for that bucket for the "Retry-After"
+ * time, or back off exponentially if it doesn't tell us.
+ *
+ * Queries are started by priority (see Query::Priority), and in the
+ * order they were queued within the same priority. A query that has
+ * been waiting for "promotion" moves up one priority, so bulk
+ * queries keep moving even if there's always something more
+ * important. Bulk queries don't get the last free slot, so a
+ * time-sensitive query doesn't have to wait for a bulk query to
+ * finish.
+ *
+ * Within the same priority, accounts take turns: each account has a
+ * virtual time that advances by 1/weight for every query it starts,
+ * and the account that is furthest behind goes next. An account
+ * that starts a large crawl only gets its share of the slots, and
+ * the others don't have to wait behind it. Accounts that had nothing
+ * queued start at the current virtual time, so they can't save up
+ * for a burst either. Weights default to 1.
+ *
+ * The time queries spend waiting in the queue is recorded in the
+ * LatencyHistograms "HTTP queue <host>/<class>", "HTTP queue (<priority>)"
+ * and "HTTP queue account <name>".
+ *
  * Note: the other RateLimit facility can't be used, because it's
  * blocking. I'll have to see where that's actually used, and whether
  * it's actually needed considering that we only need to rate-limit
@@ -45,20 +79,66 @@ namespace SteamBot
         {
         private:
             typedef std::shared_ptr<Query::WaiterType> WaiterType;
+            typedef std::chrono::steady_clock Clock;
+
+            class Queued
+            {
+            public:
+                WaiterType query;
+                std::string bucket;
+                const ClientInfo* clientInfo;
+                Query::Priority priority;
+                Clock::time_point enqueued;
+
+            public:
+                Query::Priority effectivePriority(Clock::time_point) const;
+            };
+
+            class Bucket
+            {
+            public:
+                double tokens;
+                Clock::time_point updated;
+                Clock::time_point blockedUntil;
+                Clock::duration backoff{0};
+            };
+
+            class Account
+            {
+            public:
+                double virtualTime=0;
+                unsigned int weight=1;
+                unsigned int queued=0;
+            };
 
         private:
-            const std::chrono::steady_clock::duration schedule;
+            const Clock::duration schedule;
+            const unsigned int burst;
+            const unsigned int concurrency;
+
             boost::asio::steady_timer timer;
-            std::queue<WaiterType> queue;
-            WaiterType inProgress;
+            std::list<Queued> queue;
+            std::unordered_set<WaiterType> inProgress;
+            std::map<std::string, Bucket, std::less<>> buckets;
+            std::unordered_map<const ClientInfo*, Account> accounts;
+            double virtualTime=0;
 
         private:
-            void runQuery(WaiterType);
+            Bucket& getBucket(const std::string&, Clock::time_point);
+            Account& getAccount(const ClientInfo*);
+            void runQuery(Queued);
+            void queryCompleted(const WaiterType&, const std::string&);
             void startQuery();
+            void dropExpired();
             void enqueue(WaiterType);
 
         public:
-            RateLimitQueue(std::chrono::steady_clock::duration);
+            // Call these before making queries
+            static void setPromotion(Clock::duration);
+            static void setWeight(const ClientInfo&, unsigned int);
+
+        public:
+            RateLimitQueue(Clock::duration schedule, unsigned int burst=1, unsigned int concurrency=1);
 
             RateLimitQueue(const RateLimitQueue&) =delete;
             RateLimitQueue(RateLimitQueue&&) =delete;
@@ -0,0 +1,77 @@
+/*
+ * This file is part of "Christians-Steam-Framework"
+ * Copyright (C) 2023- Christian Stieber
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 3, or (at
+ * your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; see the file LICENSE.  If not see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "Asio/Asio.hpp"
+
+#include <boost/asio/ip/tcp.hpp>
+
+#include <chrono>
+#include <functional>
+#include <string>
+
+/************************************************************************/
+/*
+ * A process-wide DNS cache.
+ *
+ *    SteamBot::Asio::Resolver::resolve(shard, host, port, callback);
+ *
+ * The callback is called on the given shard, like a completion
+ * handler of boost::asio::ip::tcp::resolver::async_resolve().
+ *
+ * The system resolver doesn't tell us the TTL of its answers, so
+ * results are kept for a configurable time. Failed lookups are
+ * cached too, but only for a short time.
+ *
+ * If a name is used when it's close to expiring, it is looked up
+ * again in the background, so frequently used names don't expire.
+ * Several queries for a name that's not cached share one lookup.
+ *
+ * Hosts with several addresses get them in a rotating order, so
+ * connections are spread out across the addresses.
+ */
+
+class SteamBot::Asio::Resolver
+{
+public:
+    typedef boost::asio::ip::tcp::resolver::results_type Results;
+    typedef std::function<void(const boost::system::error_code&, Results)> Callback;
+
+    class Statistics
+    {
+    public:
+        uint64_t hits=0;
+        uint64_t misses=0;
+        uint64_t lookups=0;
+        uint64_t prefetches=0;
+        uint64_t failures=0;
+    };
+
+public:
+    static void resolve(Shard, std::string host, std::string port, Callback);
+
+public:
+    // Call these before resolving anything
+    static void setTTL(std::chrono::steady_clock::duration);
+    static void setNegativeTTL(std::chrono::steady_clock::duration);
+
+    static Statistics getStatistics();
+    static void logStatistics();
+};
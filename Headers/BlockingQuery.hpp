@@ -19,6 +19,10 @@
 
 #include "JobID.hpp"
 #include "Modules/Connection.hpp"
+#include "Client/Deadline.hpp"
+#include "LatencyHistogram.hpp"
+#include "TypeName.hpp"
+#include "Exceptions.hpp"
 
 /************************************************************************/
 /*
@@ -31,31 +35,36 @@
  * whenever a response comes in. Return false if we expect
  * more responses, true if we're done.
  *
- * ToDo: since UnifiedMessageClient is also dealing with jobIds,
- * I should probably think about making something more generic
- * to catch messages fro specific jobIds.
+ * The responses are routed to us by jobid, so they don't go
+ * through the messageboard.
+ *
+ * If a timeout is given, or the current Deadline expires first, we
+ * throw a TimeoutException if we're not done after that time.
  */
 
 namespace SteamBot
 {
-    template <typename RESPONSE, typename REQUEST, typename FUNC> void sendAndWait(std::unique_ptr<REQUEST> request, FUNC callback)
+    template <typename RESPONSE, typename REQUEST, typename FUNC>
+    void sendAndWait(std::unique_ptr<REQUEST> request, FUNC callback, std::chrono::steady_clock::duration timeout=std::chrono::steady_clock::duration::zero())
     {
         auto& client=SteamBot::Client::getClient();
         auto waiter=SteamBot::Waiter::create();
         auto cancellation=client.cancel.registerObject(*waiter);
-        auto responseWaiterItem=client.messageboard.createWaiter<RESPONSE>(*waiter);
 
         const SteamBot::JobID jobId;
+        auto responseWaiterItem=waiter->createWaiter<SteamBot::Modules::Connection::JobWaiter<RESPONSE>>(jobId);
+
+        const auto deadline=SteamBot::Deadline::current().earliest(SteamBot::Deadline(timeout));
 
         request->header.proto.set_jobid_source(jobId.getValue());
         SteamBot::Modules::Connection::Messageboard::SendSteamMessage::send(std::move(request));
 
-        while (true)
-        {
-            waiter->wait();
-            if (auto message=responseWaiterItem->fetch())
+        SteamBot::LatencyHistogram histogram("sendAndWait "+SteamBot::typeName<RESPONSE>());
+        histogram.measure([&]() {
+            while (true)
             {
-                if (message->header.proto.jobid_target()==jobId.getValue())
+                waiter->wait(deadline);
+                while (auto message=responseWaiterItem->fetch())
                 {
                     if (callback(std::move(message)))
                     {
@@ -63,6 +72,6 @@ namespace SteamBot
                     }
                 }
             }
-        }
+        });
     }
 }
@@ -55,6 +55,7 @@ namespace SteamBot
         DataFile& dataFile;
 
 	public:
+        static void setWorkerThreads(unsigned int);
         static void launch(ClientInfo&);
         static void waitAll();
 
@@ -92,6 +93,24 @@ namespace SteamBot
             return status!=Status::Initializing;
         }
 
+    private:
+        std::unordered_map<std::type_index, std::shared_ptr<void>> locals;
+
+    public:
+        // Per-client state, for the cases that would otherwise use
+        // a thread_local -- clients may share threads. The client
+        // creates a T on first use, and keeps it until it ends.
+        template <typename T> T& getLocal()
+        {
+            assert(getClientPtr()==this);
+            auto& item=locals[std::type_index(typeid(T))];
+            if (!item)
+            {
+                item=std::make_shared<T>();
+            }
+            return *static_cast<T*>(item.get());
+        }
+
 	private:
         mutable boost::fibers::mutex modulesMutex;
         std::unordered_map<std::type_index, std::shared_ptr<Module>> modules;
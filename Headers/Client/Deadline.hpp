@@ -0,0 +1,113 @@
+/*
+ * This file is part of "Christians-Steam-Framework"
+ * Copyright (C) 2023- Christian Stieber
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 3, or (at
+ * your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; see the file LICENSE.  If not see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <chrono>
+
+/************************************************************************/
+/*
+ * A Deadline is a point in time by which an operation must be
+ * done; a default-constructed Deadline never expires.
+ *
+ * Deadlines are passed down from the caller: a Deadline::Scope sets
+ * the deadline for the current client fiber, and everything that is
+ * called while it exists -- including fibers that are launched from
+ * it -- will be done by that deadline, or throw a TimeoutException.
+ * Nested scopes can only make the deadline earlier.
+ *
+ *    SteamBot::Deadline::Scope scope(SteamBot::Deadline(std::chrono::seconds(30)));
+ *    auto response=SteamBot::HTTPClient::perform(std::move(query));
+ *
+ * Operations combine the current deadline with their own timeouts
+ * by calling Deadline::current().earliest(...).
+ */
+
+namespace SteamBot
+{
+    class Deadline
+    {
+    public:
+        typedef std::chrono::steady_clock Clock;
+
+    private:
+        Clock::time_point when=Clock::time_point::max();
+
+    public:
+        Deadline() =default;
+
+        Deadline(Clock::time_point when_)
+            : when(when_)
+        {
+        }
+
+        // a zero duration means "no deadline"
+        template <typename REP, typename PERIOD> explicit Deadline(std::chrono::duration<REP, PERIOD> duration)
+            : when(duration==duration.zero() ? Clock::time_point::max() : Clock::now()+std::chrono::duration_cast<Clock::duration>(duration))
+        {
+        }
+
+    public:
+        bool isSet() const
+        {
+            return when!=Clock::time_point::max();
+        }
+
+        Clock::time_point get() const
+        {
+            return when;
+        }
+
+        bool expired() const
+        {
+            return isSet() && Clock::now()>=when;
+        }
+
+        Clock::duration remaining() const;
+
+        Deadline earliest(const Deadline& other) const
+        {
+            return (other.when<when) ? other : *this;
+        }
+
+        // throws a TimeoutException if we're expired
+        void check() const;
+
+    public:
+        static Deadline current();
+
+    public:
+        class Scope;
+    };
+}
+
+/************************************************************************/
+
+class SteamBot::Deadline::Scope
+{
+private:
+    Deadline previous;
+
+public:
+    Scope(Deadline);
+    ~Scope();
+
+    Scope(const Scope&) =delete;
+    Scope& operator=(const Scope&) =delete;
+};
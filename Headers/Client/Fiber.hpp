@@ -22,16 +22,41 @@
 #include <boost/fiber/properties.hpp>
 #include <boost/fiber/algo/algorithm.hpp>
 #include <boost/fiber/algo/round_robin.hpp>
+#include <boost/fiber/context.hpp>
+#include <boost/fiber/condition_variable.hpp>
+#include <boost/log/trivial.hpp>
+
+#include "Client/Deadline.hpp"
+
+#include <memory>
 
 /************************************************************************/
 /*
  * This is a fiber-scheduler that counts the number of fibers...
  *
  * Note: https://github.com/boostorg/fiber/issues/308#
+ *
+ * Fibers belong to a client; the client is stored in the fiber
+ * properties, and new fibers inherit it from the fiber that created
+ * them. That's how Client::getClient() finds the client, and how we
+ * count the fibers per client -- a thread may run several clients.
+ *
+ * Fibers never move between threads, so all fibers of a client run
+ * on the same thread.
+ *
+ * The properties also hold the current Deadline of the fiber, which
+ * is inherited as well.
  */
 
 /************************************************************************/
 
+namespace SteamBot
+{
+    class Client;
+}
+
+/************************************************************************/
+
 namespace SteamBot
 {
     namespace ClientFiber
@@ -72,7 +97,6 @@ namespace SteamBot
         public:
             void setBaseCounter()
             {
-                boost::this_fiber::yield();
                 baseCounter=counter;
             }
         };
@@ -88,24 +112,52 @@ namespace SteamBot
         class Properties : public boost::fibers::fiber_properties
         {
         private:
+            std::shared_ptr<Client> client;
             std::shared_ptr<Tracker> tracker;
 
+        public:
+            Deadline deadline;
+
         public:
             Properties(boost::fibers::context* context)
                 : fiber_properties(context)
             {
-                assert(false);
             }
 
-            Properties(boost::fibers::context* context, std::shared_ptr<Tracker> tracker_)
-                : fiber_properties(context), tracker(std::move(tracker_))
+            ~Properties()
             {
-                tracker->increase();
+                setClient(nullptr, nullptr);
             }
 
-            ~Properties()
+        public:
+            void setClient(std::shared_ptr<Client> client_, std::shared_ptr<Tracker> tracker_)
+            {
+                if (tracker) tracker->decrease();
+                client=std::move(client_);
+                tracker=std::move(tracker_);
+                if (tracker) tracker->increase();
+            }
+
+            void inherit(const Properties& other)
             {
-                tracker->decrease();
+                setClient(other.client, other.tracker);
+                deadline=other.deadline;
+            }
+
+            const std::shared_ptr<Client>& getClient() const
+            {
+                return client;
+            }
+
+        public:
+            // returns nullptr if we're not on a client fiber
+            static Properties* get()
+            {
+                if (auto context=boost::fibers::context::active())
+                {
+                    return dynamic_cast<Properties*>(context->get_properties());
+                }
+                return nullptr;
             }
         };
     }
@@ -121,13 +173,9 @@ namespace SteamBot
         {
         public:
             boost::fibers::algo::round_robin scheduler;
-            std::shared_ptr<Tracker> tracker{std::make_shared<Tracker>()};
 
         public:
-            Scheduler(Scheduler*& self)
-            {
-                self=this;
-            }
+            Scheduler() =default;
 
         public:
             virtual void awakened(boost::fibers::context* context, Properties&) noexcept // override
@@ -156,19 +204,20 @@ namespace SteamBot
             }
 
         public:
+            // This is called when a new fiber is scheduled for the
+            // first time, which happens on the fiber that launches it.
+            // Main and dispatcher contexts never belong to a client.
             virtual boost::fibers::fiber_properties* new_properties(boost::fibers::context* context) override
             {
-                return new Properties(context, tracker);
-            }
-
-            void wait()
-            {
-                tracker->wait();
-            }
-
-            void setBaseCounter()
-            {
-                tracker->setBaseCounter();
+                auto properties=new Properties(context);
+                if (context->is_context(boost::fibers::type::worker_context))
+                {
+                    if (auto creator=Properties::get())
+                    {
+                        properties->inherit(*creator);
+                    }
+                }
+                return properties;
             }
         };
     }
@@ -19,13 +19,16 @@
 
 #pragma once
 
-#include <unordered_map>
 #include <type_traits>
-#include <typeindex>
 #include <memory>
-#include <queue>
+#include <vector>
+
+#include <boost/fiber/mutex.hpp>
+#include <boost/fiber/condition_variable.hpp>
 
 #include "Waiter.hpp"
+#include "Vector.hpp"
+#include "TypeName.hpp"
 
 /************************************************************************/
 /*
@@ -39,6 +42,20 @@
  *
  * Note that you can wait for messages, using the same "Waiter"
  * mechanism used for the Whiteboard.
+ *
+ * Each subscription has its own queue. By default, the queue can
+ * grow without limits; pass a QueuePolicy to createWaiter() to
+ * bound it:
+ *   - Block: send() waits until the receiver has fetched a message.
+ *     Don't use this for messages a module sends to itself.
+ *   - DropOldest: the oldest queued message is discarded
+ *   - Coalesce: a new message replaces a queued message with the
+ *     same key, keeping its place in the queue. The key is
+ *     "message.coalesceKey()" if the message type has one;
+ *     otherwise, all messages of the type share the same key, so
+ *     only the most recent one is kept.
+ *     If the queue has a capacity, it drops the oldest message when
+ *     it's full.
  */
 
 /************************************************************************/
@@ -51,11 +68,90 @@ namespace SteamBot
         class WaiterBase;
         template <typename T> class Waiter;
 
+        class QueuePolicy
+        {
+        public:
+            enum class Overflow { Block, DropOldest, Coalesce };
+
+        public:
+            size_t capacity=0;		// 0 means "unbounded"
+            Overflow overflow=Overflow::Block;
+
+        public:
+            static QueuePolicy coalesce()
+            {
+                return QueuePolicy{0, Overflow::Coalesce};
+            }
+        };
+
+        class QueueStatistics
+        {
+        public:
+            size_t depth=0;
+            size_t maxDepth=0;
+            uint64_t received=0;
+            uint64_t dropped=0;
+            uint64_t coalesced=0;
+            uint64_t blocked=0;
+        };
+
+    private:
+        typedef size_t Slot;
+
+        static Slot nextSlot();
+
+        template <typename T> static Slot getSlot()
+        {
+            static const Slot slot=nextSlot();
+            return slot;
+        }
+
+    private:
+        class SubscribersBase
+        {
+        public:
+            virtual ~SubscribersBase() =default;
+            virtual bool empty() const =0;
+        };
+
+        template <typename T> class Subscribers : public SubscribersBase
+        {
+        public:
+            std::vector<std::weak_ptr<Waiter<T>>> waiters;
+            bool hasBlocking=false;
+
+        public:
+            virtual ~Subscribers() =default;
+
+            virtual bool empty() const override
+            {
+                return waiters.empty();
+            }
+
+            void cleanup()
+            {
+                hasBlocking=false;
+                SteamBot::erase(waiters, [this](const std::weak_ptr<Waiter<T>>& waiter) {
+                    auto locked=waiter.lock();
+                    if (!locked) return true;
+                    if (locked->isBlocking()) hasBlocking=true;
+                    return false;
+                });
+            }
+        };
+
     private:
-        std::unordered_map<std::type_index, std::vector<std::weak_ptr<WaiterBase>>> waiters;
+        std::vector<std::unique_ptr<SubscribersBase>> subscribers;
 
     private:
-        void action(const std::type_index&, std::function<void(std::shared_ptr<WaiterBase>)>);
+        template <typename T> Subscribers<T>& getSubscribers()
+        {
+            const auto slot=getSlot<T>();
+            if (slot>=subscribers.size()) subscribers.resize(slot+1);
+            auto& item=subscribers[slot];
+            if (!item) item=std::make_unique<Subscribers<T>>();
+            return *static_cast<Subscribers<T>*>(item.get());
+        }
 
     public:
         Messageboard();
@@ -70,9 +166,9 @@ namespace SteamBot
     public:
         template <typename T> using WaiterType=std::shared_ptr<Waiter<T>>;
 
-        template <typename T> WaiterType<T> createWaiter(SteamBot::Waiter& waiter)
+        template <typename T> WaiterType<T> createWaiter(SteamBot::Waiter& waiter, QueuePolicy policy={})
         {
-            return waiter.createWaiter<Waiter<T>>(*this);
+            return waiter.createWaiter<Waiter<T>>(*this, policy);
         }
     };
 }
@@ -81,6 +177,12 @@ namespace SteamBot
 
 namespace SteamBot
 {
+    template <typename MESSAGE> concept CoalescableMessage =
+        requires(const MESSAGE& message)
+        {
+            message.coalesceKey()==message.coalesceKey();
+        };
+
     // https://stackoverflow.com/a/61034367
 
     // Note: when declaring a "concept", we use a "requires
@@ -99,17 +201,35 @@ class SteamBot::Messageboard::WaiterBase : public SteamBot::WaiterBase::ItemBase
 {
 protected:
     Messageboard& messageboard;
+    const QueuePolicy policy;
+    QueueStatistics statistics;
+
+    WaiterBase(std::shared_ptr<SteamBot::WaiterBase>, Messageboard&, QueuePolicy);
 
-    WaiterBase(std::shared_ptr<SteamBot::WaiterBase>, Messageboard&);
+    void logStatistics(const std::string&) const;
 
 public:
     virtual ~WaiterBase();
+
+public:
+    const QueueStatistics& getStatistics() const
+    {
+        return statistics;
+    }
+
+    bool isBlocking() const
+    {
+        return policy.capacity>0 && policy.overflow==QueuePolicy::Overflow::Block;
+    }
 };
 
 /************************************************************************/
 /*
  * Call fetch() to get the next message.
  * You'll get a nullptr message if there aren't any left.
+ *
+ * Messages are kept in a ring buffer; it only grows if the queue is
+ * unbounded.
  */
 
 template <typename T> class SteamBot::Messageboard::Waiter : public SteamBot::Messageboard::WaiterBase
@@ -118,38 +238,158 @@ public:
     typedef T value_type;
 
 private:
-    std::queue<std::shared_ptr<const T>> messages;
+    // The messageboard belongs to its client, so senders and the
+    // receiver are fibers on the same thread, and the queue itself
+    // needs no lock.
+    std::vector<std::shared_ptr<const T>> messages;
+    size_t head=0;
+    size_t queued=0;
+
+    // Only for the space notification: cancel() can come from another
+    // thread, and must not slip in between the check and the wait in
+    // waitForSpace().
+    boost::fibers::mutex mutex;
+    boost::fibers::condition_variable spaceAvailable;
 
 public:
     virtual ~Waiter()
     {
-        messageboard.action(std::type_index(typeid(T)), nullptr);
+        if (statistics.dropped>0 || statistics.blocked>0)
+        {
+            logStatistics(SteamBot::typeName<T>());
+        }
+        messageboard.getSubscribers<T>().cleanup();
     }
 
 public:
-    Waiter(std::shared_ptr<SteamBot::WaiterBase> waiter_, Messageboard& messageboard_)
-        : WaiterBase(std::move(waiter_), messageboard_)
+    Waiter(std::shared_ptr<SteamBot::WaiterBase> waiter_, Messageboard& messageboard_, QueuePolicy policy_={})
+        : WaiterBase(std::move(waiter_), messageboard_, policy_)
     {
+        messages.resize(policy.capacity>0 ? policy.capacity : 4);
     }
 
 public:
     virtual void install(std::shared_ptr<ItemBase> item) override
     {
-        auto ourItem=std::dynamic_pointer_cast<SteamBot::Messageboard::WaiterBase>(item);
+        auto ourItem=std::dynamic_pointer_cast<Waiter<T>>(item);
         assert(ourItem);
-        messageboard.waiters[std::type_index(typeid(T))].emplace_back(ourItem);
+        auto& list=messageboard.getSubscribers<T>();
+        list.cleanup();
+        if (isBlocking())
+        {
+            list.hasBlocking=true;
+            listenForCancel(ourItem);
+        }
+        list.waiters.emplace_back(std::move(ourItem));
+    }
+
+    // wake up senders that are blocked in waitForSpace()
+    virtual void cancelled() override
+    {
+        notifySpace();
     }
 
 public:
     virtual bool isWoken() const override
     {
-        return !messages.empty();
+        return queued>0;
+    }
+
+private:
+    void notifySpace()
+    {
+        std::lock_guard<decltype(mutex)> lock(mutex);
+        spaceAvailable.notify_all();
+    }
+
+    std::shared_ptr<const T> pop()
+    {
+        assert(queued>0);
+        auto message=std::move(messages[head]);
+        head=(head+1)%messages.size();
+        queued--;
+        if (isBlocking()) notifySpace();
+        return message;
+    }
+
+    // replaces a queued message with the same key
+    bool coalesce(std::shared_ptr<const T>& message)
+    {
+        for (size_t i=0; i<queued; i++)
+        {
+            auto& queuedMessage=messages[(head+i)%messages.size()];
+            bool sameKey=true;
+            if constexpr (CoalescableMessage<T>)
+            {
+                sameKey=(queuedMessage->coalesceKey()==message->coalesceKey());
+            }
+            if (sameKey)
+            {
+                queuedMessage=std::move(message);
+                statistics.coalesced++;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void push(std::shared_ptr<const T> message)
+    {
+        if (queued==messages.size())
+        {
+            assert(policy.capacity==0);
+            std::vector<std::shared_ptr<const T>> larger(messages.size()*2);
+            for (size_t i=0; i<queued; i++)
+            {
+                larger[i]=std::move(messages[(head+i)%messages.size()]);
+            }
+            messages=std::move(larger);
+            head=0;
+        }
+        messages[(head+queued)%messages.size()]=std::move(message);
+        queued++;
+    }
+
+    // Block until there's space, unless our waiter gets cancelled
+    void waitForSpace()
+    {
+        bool blocked=false;
+        std::unique_lock<decltype(mutex)> lock(mutex);
+        while (queued>=policy.capacity && !isCancelled())
+        {
+            blocked=true;
+            spaceAvailable.wait(lock);
+        }
+        if (blocked) statistics.blocked++;
     }
 
 public:
-    void received(const std::shared_ptr<T>& message)
+    void received(const std::shared_ptr<T>& message_)
     {
-        messages.emplace(std::const_pointer_cast<const T, T>(message));
+        auto message=std::const_pointer_cast<const T, T>(message_);
+        statistics.received++;
+        if (policy.overflow==QueuePolicy::Overflow::Coalesce)
+        {
+            if (coalesce(message))
+            {
+                return;
+            }
+        }
+        if (policy.capacity>0 && queued>=policy.capacity)
+        {
+            if (policy.overflow==QueuePolicy::Overflow::Block)
+            {
+                waitForSpace();
+            }
+            while (queued>=policy.capacity)
+            {
+                pop();
+                statistics.dropped++;
+            }
+        }
+        push(std::move(message));
+        statistics.depth=queued;
+        if (queued>statistics.maxDepth) statistics.maxDepth=queued;
         wakeup();
     }
 
@@ -157,10 +397,10 @@ public:
     std::shared_ptr<const T> fetch()
     {
         std::shared_ptr<const T> message;
-        if (!messages.empty())
+        if (queued>0)
         {
-            message=std::move(messages.front());
-            messages.pop();
+            message=pop();
+            statistics.depth=queued;
         }
         return message;
     }
@@ -183,7 +423,11 @@ public:
 public:
     void discardMessages()
     {
-        messages=decltype(messages)();
+        while (queued>0)
+        {
+            pop();
+        }
+        statistics.depth=0;
     }
 };
 
@@ -199,13 +443,39 @@ template <typename T> unsigned int SteamBot::Messageboard::send(const std::share
     // ToDo: add handling of std::shared_ptr<const T>, instead of just rejecting it
     static_assert(!std::is_const_v<T>, "message parameter must not be const, for now. We don't change it, promise.");
 
+    // the list is cleaned up by install() and ~Waiter(), so it might
+    // still have expired entries, but hasBlocking is current
+    auto& list=getSubscribers<T>();
+
     unsigned int count=0;
-    std::type_index key(typeid(T));
-    action(key, [&count, &message](std::shared_ptr<WaiterBase> item) {
-        auto waiter=std::dynamic_pointer_cast<SteamBot::Messageboard::Waiter<T>>(item);
-        assert(waiter);
-        waiter->received(message);
-        count++;
-    });
+    if (!list.hasBlocking)
+    {
+        for (const auto& waiter : list.waiters)
+        {
+            if (auto locked=waiter.lock())
+            {
+                locked->received(message);
+                count++;
+            }
+        }
+    }
+    else
+    {
+        // received() may block, so the list can change while we're at it
+        std::vector<std::shared_ptr<Waiter<T>>> waiters;
+        waiters.reserve(list.waiters.size());
+        for (const auto& waiter : list.waiters)
+        {
+            if (auto locked=waiter.lock())
+            {
+                waiters.push_back(std::move(locked));
+            }
+        }
+        for (const auto& waiter : waiters)
+        {
+            waiter->received(message);
+            count++;
+        }
+    }
     return count;
 }
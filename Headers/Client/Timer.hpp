@@ -0,0 +1,122 @@
+/*
+ * This file is part of "Christians-Steam-Framework"
+ * Copyright (C) 2023- Christian Stieber
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 3, or (at
+ * your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; see the file LICENSE.  If not see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "Client/Waiter.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+
+/************************************************************************/
+/*
+ * A Timer is a waiter item that becomes active when its deadline
+ * has passed. Use it instead of waiter->wait(duration) or
+ * sleep_for() for timeouts and periodic work:
+ *
+ *    auto timer=waiter->createWaiter<SteamBot::Timer>();
+ *    timer->setInterval(std::chrono::minutes(10), std::chrono::seconds(30));
+ *    while (true)
+ *    {
+ *        waiter->wait();
+ *        if (timer->testAndClear())
+ *        {
+ *            ...
+ *        }
+ *    }
+ *
+ * All timers of a client live in a hierarchical timer wheel, which
+ * is served by a single fiber. The wheel counts in ticks of
+ * "resolution"; a timer never fires early, but it may fire up to
+ * "slack" late. Deadlines are rounded up to the coarsest tick
+ * boundary that the slack allows, so timers with a similar slack
+ * fire on the same tick -- for the client, but also for all other
+ * clients on the same thread, since tick boundaries are the same
+ * everywhere.
+ *
+ * Timers can only be used from the fibers of their client.
+ */
+
+/************************************************************************/
+
+namespace SteamBot
+{
+    class Timer : public Waiter::ItemBase
+    {
+    public:
+        typedef std::shared_ptr<Timer> WaiterType;
+        typedef std::chrono::steady_clock Clock;
+
+    public:
+        class Wheel;
+
+    private:
+        const std::shared_ptr<Wheel> wheel;
+        std::weak_ptr<Timer> self;
+
+        Clock::time_point deadline;
+        Clock::duration slack=Clock::duration::zero();
+        Clock::duration interval=Clock::duration::zero();
+        uint64_t expires=0;
+
+        // position in the wheel
+        uint8_t level=0;
+        uint8_t slot=0;
+        uint32_t index=0;
+        bool armed=false;
+
+        std::atomic<bool> expired{false};
+
+    private:
+        uint64_t getExpires() const;
+        void arm(Clock::time_point, Clock::duration);
+
+    public:
+        virtual bool isWoken() const override;
+        virtual void install(std::shared_ptr<ItemBase>) override;
+
+    public:
+        Timer(std::shared_ptr<SteamBot::WaiterBase>&&);
+        virtual ~Timer();
+
+    public:
+        // the duration/time_point are the earliest time to fire,
+        // the slack is how much later we can tolerate
+        void setTimeout(Clock::duration, Clock::duration slack=Clock::duration::zero());
+        void setDeadline(Clock::time_point, Clock::duration slack=Clock::duration::zero());
+
+        // fire every "interval", until stopped or changed
+        void setInterval(Clock::duration, Clock::duration slack=Clock::duration::zero());
+
+        void stop();
+        bool testAndClear();
+
+    public:
+        // Call this before starting clients
+        static void setResolution(std::chrono::milliseconds);
+
+    public:
+        static WaiterType createWaiter(SteamBot::Waiter& waiter)
+        {
+            return waiter.createWaiter<Timer>();
+        }
+    };
+}
@@ -23,6 +23,8 @@
 #include <boost/fiber/condition_variable.hpp>
 #include <boost/log/trivial.hpp>
 
+#include "Client/Deadline.hpp"
+
 #include <vector>
 
 /************************************************************************/
@@ -49,6 +51,10 @@
  * will be called during createWaiter().
  *
  * "Waiter" is the actual waiter class.
+ *
+ * Items call wakeup() when they become active; the Waiter keeps these
+ * on a "ready list", so wait() only has to look at the items that
+ * have actually fired instead of checking every attached item.
  */
 
 /************************************************************************/
@@ -56,6 +62,7 @@
 #include <memory>
 #include <atomic>
 #include <vector>
+#include <algorithm>
 
 /************************************************************************/
 
@@ -70,15 +77,24 @@ namespace SteamBot
         std::atomic<bool> cancelled{false};
 
     private:
-        std::vector<std::weak_ptr<ItemBase>> items;
+        boost::fibers::mutex cancelMutex;
+        std::vector<std::weak_ptr<ItemBase>> cancelListeners;
+
+        void addCancelListener(std::weak_ptr<ItemBase>);
+        void notifyCancelListeners();
+
+        static void wakeupIfWoken(ItemBase&);
 
     public:
         virtual void wakeup(ItemBase*) =0;	// make this threadsafe!
         void cancel();
 
+    protected:
+        // called when an item is destroyed
+        virtual void removeItem(ItemBase*);
+
     protected:
         WaiterBase();
-        bool isWoken();
 
     public:
         virtual ~WaiterBase();
@@ -92,7 +108,6 @@ namespace SteamBot
         template <typename T, typename... ARGS> requires std::is_base_of_v<ItemBase, T> std::shared_ptr<T> createWaiter(ARGS&&... args)
         {
             auto item=std::make_shared<T>(shared_from_this(), std::forward<ARGS>(args)...);
-            items.push_back(item);	// we could do this in ItemBase, but lets play it safe in case it's not forwarded from the derived class
 
             if constexpr (HasStaticCreatedWaiter<T>::value)
             {
@@ -100,6 +115,7 @@ namespace SteamBot
             }
 
             item->install(item);
+            wakeupIfWoken(*item);
             return item;
         }
     };
@@ -110,10 +126,14 @@ namespace SteamBot
 class SteamBot::WaiterBase::ItemBase
 {
     friend class WaiterBase;
+    friend class Waiter;
 
 private:
     std::weak_ptr<WaiterBase> waiter;
 
+    // protected by the mutex of a Waiter
+    bool ready=false;
+
 public:
     ItemBase(std::shared_ptr<WaiterBase>_);
     virtual ~ItemBase();
@@ -121,6 +141,16 @@ public:
 public:
     void wakeup();		// Note: this is threadsafe
 
+    // our waiter has been cancelled, or doesn't exist anymore
+    bool isCancelled() const;
+
+    // called when our waiter is cancelled or destroyed, if the item
+    // has called listenForCancel(). Must be threadsafe.
+    virtual void cancelled();
+
+protected:
+    void listenForCancel(std::shared_ptr<ItemBase>);
+
 public:
     virtual void install(std::shared_ptr<ItemBase>);
     virtual bool isWoken() const =0;		// Must be threadsafe
@@ -131,7 +161,10 @@ public:
  * The "Waiter" class is the classic waiter.
  *
  * Call wait() to block the calling fiber until one of the attached
- * items wakes it up.
+ * items wakes it up. It returns the items that are active, so
+ * callers don't have to check all of their items; the list is only
+ * valid until the next wait(). The timed wait() calls return a bool,
+ * so use getFired() for these.
  *
  * Call cancel() to abort ongoing wait() calls. These will throw an
  * OperationCancelledException.
@@ -144,9 +177,16 @@ namespace SteamBot
     private:
         boost::fibers::mutex mutex;
         boost::fibers::condition_variable condition;
+        std::vector<ItemBase*> readyItems;
+
+        // only used by the fiber calling wait()
+        std::vector<ItemBase*> fired;
 
     private:
         virtual void wakeup(ItemBase*) override;
+        virtual void removeItem(ItemBase*) override;
+
+        bool isWoken();
 
     protected:
         Waiter();
@@ -154,11 +194,24 @@ namespace SteamBot
     public:
         virtual ~Waiter();
 
-        void wait();
+        const std::vector<ItemBase*>& wait();
         bool wait(std::chrono::milliseconds);
 
         template <typename CLOCK> bool wait(CLOCK::time_point);
 
+        // throws a TimeoutException if the deadline expires first
+        const std::vector<ItemBase*>& wait(const Deadline&);
+
+        const std::vector<ItemBase*>& getFired() const
+        {
+            return fired;
+        }
+
+        bool hasFired(const ItemBase* item) const
+        {
+            return std::find(fired.begin(), fired.end(), item)!=fired.end();
+        }
+
     public:
         static std::shared_ptr<Waiter> create();
     };
@@ -19,9 +19,12 @@
 
 #pragma once
 
-#include <unordered_map>
-#include <typeindex>
+#include <array>
+#include <atomic>
 #include <memory>
+#include <vector>
+#include <functional>
+#include <type_traits>
 
 #include "Waiter.hpp"
 
@@ -52,8 +55,40 @@
  *
  * has<T> returns a pointer to the stored item, or nullptr.  This
  * pointer is valid until a yield.
+ *
+ * References and cv-qualifiers on T are ignored: has<const Foo&>
+ * finds the item stored by set<Foo>.
+ *
+ * Internally, every type gets a small number (its "slot") the first
+ * time it's used with any whiteboard; items and waiters are stored
+ * in vectors indexed by the slot, so accessing them is just an
+ * index and doesn't need RTTI.
  */
 
+/************************************************************************/
+/*
+ * Snapshots: the whiteboard is not threadsafe; it must only be used
+ * from the fibers of its client.
+ *
+ * Some items are also useful to other threads -- think of the UI
+ * listing the licenses of all accounts. Items that are immutable
+ * objects held by a std::shared_ptr<const X> can be published as
+ * snapshots:
+ *
+ *    template <> struct SteamBot::PublishSnapshot<X::Ptr> : std::true_type { };
+ *
+ * Whenever such an item is set or cleared, the whiteboard also
+ * stores the pointer into an atomic, and any thread can read it
+ * with getSnapshot<T>() without involving the client. The snapshot
+ * is just another reference to the same object, so it stays valid
+ * for as long as the reader keeps it.
+ */
+
+namespace SteamBot
+{
+    template <typename T> struct PublishSnapshot : std::false_type { };
+}
+
 /************************************************************************/
 /*
  * To wait for items to change, use the Whiteboard::Waiter<T> class.
@@ -91,12 +126,53 @@ namespace SteamBot
         template <typename T> class Waiter;
 
     private:
-        std::unordered_map<std::type_index, std::unique_ptr<ItemBase>> items;
-        std::unordered_map<std::type_index, std::vector<std::weak_ptr<WaiterBase>>> waiters;
+        typedef size_t Slot;
+
+        static Slot nextSlot();
+
+        template <typename T> static Slot getSlot()
+        {
+            static const Slot slot=nextSlot();
+            return slot;
+        }
 
     private:
-        void action(const std::type_index&, std::function<void(std::shared_ptr<WaiterBase>)>);
-        void didChange(const std::type_index&);
+        // nextSnapshotSlot() throws once this is exceeded
+        static constexpr Slot maxSnapshots=16;
+
+        static Slot nextSnapshotSlot();
+
+        template <typename T> static Slot getSnapshotSlot()
+        {
+            static const Slot slot=nextSnapshotSlot();
+            return slot;
+        }
+
+        template <typename T> void publish(const T*);
+
+    private:
+        std::vector<std::unique_ptr<ItemBase>> items;
+        std::vector<std::vector<std::weak_ptr<WaiterBase>>> waiters;
+
+        // these can be read from any thread
+        std::array<std::atomic<std::shared_ptr<const void>>, maxSnapshots> snapshots;
+
+    private:
+        std::unique_ptr<ItemBase>& getItem(Slot slot)
+        {
+            if (slot>=items.size()) items.resize(slot+1);
+            return items[slot];
+        }
+
+        ItemBase* findItem(Slot slot) const
+        {
+            return (slot<items.size()) ? items[slot].get() : nullptr;
+        }
+
+    private:
+        void action(Slot, std::function<void(std::shared_ptr<WaiterBase>)>);
+        void didChange(Slot);
+        void addWaiter(Slot, std::shared_ptr<WaiterBase>);
 
     public:
         Whiteboard();
@@ -111,15 +187,18 @@ namespace SteamBot
         template <typename T> void clear();
 
         // nullptr if not exists
-        template <typename T> const T* has() const;
+        template <typename T> const CleanType<T>* has() const;
 
         // assert if not exists
-        template <typename T> const T& get() const requires (!std::is_scalar_v<T>);
-        template <typename T> T get() const requires (std::is_scalar_v<T>);
+        template <typename T> const CleanType<T>& get() const requires (!std::is_scalar_v<CleanType<T>>);
+        template <typename T> CleanType<T> get() const requires (std::is_scalar_v<CleanType<T>>);
 
 		// default value if not exists
-        template <typename T> const T& get(const T&) const requires (!std::is_scalar_v<T>);
-        template <typename T> T get(T) const requires (std::is_scalar_v<T>);
+        template <typename T> const CleanType<T>& get(const CleanType<T>&) const requires (!std::is_scalar_v<CleanType<T>>);
+        template <typename T> CleanType<T> get(T) const requires (std::is_scalar_v<CleanType<T>>);
+
+        // threadsafe; nullptr if not exists
+        template <typename T> T getSnapshot() const requires (PublishSnapshot<T>::value);
 
     public:
         template <typename T> using WaiterType=std::shared_ptr<Waiter<T>>;
@@ -159,10 +238,13 @@ public:
 
 template <typename T> class SteamBot::Whiteboard::Waiter : public SteamBot::Whiteboard::WaiterBase
 {
+private:
+    typedef CleanType<T> ValueType;
+
 public:
     virtual ~Waiter()
     {
-        whiteboard.action(std::type_index(typeid(T)), nullptr);
+        whiteboard.action(getSlot<ValueType>(), nullptr);
     }
 
 public:
@@ -175,43 +257,43 @@ public:
     {
         auto ourItem=std::dynamic_pointer_cast<SteamBot::Whiteboard::WaiterBase>(item);
         assert(ourItem);
-        whiteboard.waiters[std::type_index(typeid(T))].emplace_back(ourItem);
+        whiteboard.addWaiter(getSlot<ValueType>(), std::move(ourItem));
 
-        if (whiteboard.has<T>()!=nullptr)
+        if (whiteboard.has<ValueType>()!=nullptr)
         {
             setChanged();
         }
     }
 
 public:
-    const T* has()
+    const ValueType* has()
     {
         resetChanged();
-        return whiteboard.has<T>();
+        return whiteboard.has<ValueType>();
     }
 
-    const T& get(const T& def) requires (!std::is_scalar_v<T>)
+    const ValueType& get(const ValueType& def) requires (!std::is_scalar_v<ValueType>)
     {
         resetChanged();
-        return whiteboard.get<T>(def);
+        return whiteboard.get<ValueType>(def);
     }
 
-    T get(T def) requires (std::is_scalar_v<T>)
+    ValueType get(ValueType def) requires (std::is_scalar_v<ValueType>)
     {
         resetChanged();
-        return whiteboard.get<T>(def);
+        return whiteboard.get<ValueType>(def);
     }
 
-    const T& get() requires (!std::is_scalar_v<T>)
+    const ValueType& get() requires (!std::is_scalar_v<ValueType>)
     {
         resetChanged();
-        return whiteboard.get<T>();
+        return whiteboard.get<ValueType>();
     }
 
-    T get() requires (std::is_scalar_v<T>)
+    ValueType get() requires (std::is_scalar_v<ValueType>)
     {
         resetChanged();
-        return whiteboard.get<T>();
+        return whiteboard.get<ValueType>();
     }
 };
 
@@ -246,16 +328,17 @@ public:
 
 template <typename T> void SteamBot::Whiteboard::set(T&& data)
 {
-    std::type_index key(typeid(CleanType<T>));
-    auto& item=items[key];
+    const auto key=getSlot<CleanType<T>>();
+    auto& item=getItem(key);
     if (item)
     {
-        dynamic_cast<Item<CleanType<T>>*>(item.get())->data=std::forward<T>(data);
+        static_cast<Item<CleanType<T>>*>(item.get())->data=std::forward<T>(data);
     }
     else
     {
         item.reset(new Item<CleanType<T>>(std::forward<T>(data)));
     }
+    publish(&static_cast<Item<CleanType<T>>*>(item.get())->data);
     didChange(key);
 }
 
@@ -263,16 +346,17 @@ template <typename T> void SteamBot::Whiteboard::set(T&& data)
 
 template <typename T, typename... ARGS> void SteamBot::Whiteboard::set(ARGS&& ...args)
 {
-    std::type_index key(typeid(CleanType<T>));
-    auto& item=items[key];
+    const auto key=getSlot<CleanType<T>>();
+    auto& item=getItem(key);
     if (item)
     {
-        dynamic_cast<Item<CleanType<T>>*>(item.get())->data=T(std::forward<ARGS>(args)...);
+        static_cast<Item<CleanType<T>>*>(item.get())->data=T(std::forward<ARGS>(args)...);
     }
     else
     {
         item.reset(new Item<CleanType<T>>(std::forward<ARGS>(args)...));
     }
+    publish(&static_cast<Item<CleanType<T>>*>(item.get())->data);
     didChange(key);
 }
 
@@ -280,56 +364,76 @@ template <typename T, typename... ARGS> void SteamBot::Whiteboard::set(ARGS&& ..
 
 template <typename T> void SteamBot::Whiteboard::clear()
 {
-    std::type_index key(typeid(T));
-    items.erase(key);
+    const auto key=getSlot<CleanType<T>>();
+    if (key<items.size())
+    {
+        items[key].reset();
+    }
+    publish<CleanType<T>>(nullptr);
     didChange(key);
 }
 
 /************************************************************************/
 
-template <typename T> const T* SteamBot::Whiteboard::has() const
+template <typename T> void SteamBot::Whiteboard::publish(const T* data)
+{
+    if constexpr (PublishSnapshot<T>::value)
+    {
+        static_assert(std::is_same_v<T, std::shared_ptr<const typename T::element_type>>);
+        snapshots[getSnapshotSlot<T>()].store((data!=nullptr) ? *data : nullptr);
+    }
+}
+
+/************************************************************************/
+
+template <typename T> T SteamBot::Whiteboard::getSnapshot() const requires (PublishSnapshot<T>::value)
+{
+    return std::static_pointer_cast<typename T::element_type>(snapshots[getSnapshotSlot<T>()].load());
+}
+
+/************************************************************************/
+
+template <typename T> const SteamBot::Whiteboard::CleanType<T>* SteamBot::Whiteboard::has() const
 {
-    auto iterator=items.find(std::type_index(typeid(T)));
-    if (iterator==items.end())
+    auto item=findItem(getSlot<CleanType<T>>());
+    if (item==nullptr)
     {
         return nullptr;
     }
-    auto foo=iterator->second.get();
-    auto item=dynamic_cast<Item<T>*>(foo);
-    assert(item!=nullptr);
-    return &(item->data);
+    assert(dynamic_cast<Item<CleanType<T>>*>(item)!=nullptr);
+    return &(static_cast<Item<CleanType<T>>*>(item)->data);
 }
 
 /************************************************************************/
 
-template <typename T> const T& SteamBot::Whiteboard::get(const T& def) const requires (!std::is_scalar_v<T>)
+template <typename T> const SteamBot::Whiteboard::CleanType<T>& SteamBot::Whiteboard::get(const CleanType<T>& def) const requires (!std::is_scalar_v<CleanType<T>>)
 {
-    const T* data=has<CleanType<T>>();
+    const auto* data=has<T>();
     return (data==nullptr) ? def : *data;
 }
 
 /************************************************************************/
 
-template <typename T> T SteamBot::Whiteboard::get(T def) const requires (std::is_scalar_v<T>)
+template <typename T> SteamBot::Whiteboard::CleanType<T> SteamBot::Whiteboard::get(T def) const requires (std::is_scalar_v<CleanType<T>>)
 {
-    const T* data=has<CleanType<T>>();
+    const auto* data=has<T>();
     return (data==nullptr) ? def : *data;
 }
 
 /************************************************************************/
 
-template <typename T> const T& SteamBot::Whiteboard::get() const requires (!std::is_scalar_v<T>)
+template <typename T> const SteamBot::Whiteboard::CleanType<T>& SteamBot::Whiteboard::get() const requires (!std::is_scalar_v<CleanType<T>>)
 {
-    const T* data=has<CleanType<T>>();
+    const auto* data=has<T>();
     assert(data!=nullptr);
     return *data;
 }
 
 /************************************************************************/
 
-template <typename T> T SteamBot::Whiteboard::get() const requires (std::is_scalar_v<T>)
+template <typename T> SteamBot::Whiteboard::CleanType<T> SteamBot::Whiteboard::get() const requires (std::is_scalar_v<CleanType<T>>)
 {
-    const T* data=has<CleanType<T>>();
+    const auto* data=has<T>();
     assert(data!=nullptr);
     return *data;
 }
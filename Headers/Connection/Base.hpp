@@ -20,6 +20,7 @@
 #pragma once
 
 #include "Connection/Endpoint.hpp"
+#include "Connection/PacketBuffer.hpp"
 
 #include <span>
 
@@ -27,6 +28,9 @@
 /*
  * This is an abstract base that acts as an interface; it's bascially
  * the IConnection of SteamKit2.
+ *
+ * writePackets() sends a number of packets in one go; the default
+ * just calls writePacket() for each of them.
  */
 
 namespace SteamBot
@@ -48,8 +52,9 @@ namespace SteamBot
         public:
             virtual void connect(const Endpoint&) =0;
             virtual void disconnect() =0;
-            virtual MutableBytes readPacket() =0;
+            virtual PacketBuffer readPacket() =0;
             virtual void writePacket(ConstBytes) =0;
+            virtual void writePackets(std::span<const ConstBytes>);
 
             virtual void getLocalAddress(Endpoint&) const =0;
 
@@ -21,6 +21,8 @@
 
 #include "Connection/Base.hpp"
 
+#include <vector>
+
 /************************************************************************/
 
 namespace SteamBot
@@ -53,7 +55,8 @@ namespace SteamBot
             std::unique_ptr<SteamBot::OpenSSL::AESCryptoBase> encryptionEngine;
             enum class EncryptionState { None, Challenged, Encrypting } encryptionState=EncryptionState::None;
 
-            std::vector<std::byte> readBuffer;	// since readPacket() only returns an std::span... maybe not the best idea
+            std::vector<std::byte> writeBuffer;
+            std::vector<ConstBytes> writeChunks;
 
         private:
             void handleEncryptRequest(ConstBytes);
@@ -67,8 +70,9 @@ namespace SteamBot
         public:
             virtual void connect(const Endpoint&) override;
             virtual void disconnect() override;
-            virtual MutableBytes readPacket() override;
+            virtual PacketBuffer readPacket() override;
             virtual void writePacket(ConstBytes) override;
+            virtual void writePackets(std::span<const ConstBytes>) override;
 
             virtual void getLocalAddress(Endpoint&) const override;
 
@@ -0,0 +1,99 @@
+/*
+ * This file is part of "Christians-Steam-Framework"
+ * Copyright (C) 2023- Christian Stieber
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 3, or (at
+ * your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; see the file LICENSE.  If not see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <span>
+
+/************************************************************************/
+/*
+ * A PacketBuffer holds the bytes of a packet received from Steam.
+ *
+ * The memory comes from a process-wide pool, and goes back to the
+ * pool when the last PacketBuffer referring to it is destroyed.
+ * Copying a PacketBuffer only copies the reference, so a packet can
+ * be read by the socket, decrypted in place, queued for the client
+ * thread and deserialized without copying the bytes around.
+ *
+ * narrow() restricts the buffer to a part of itself; the Encrypted
+ * connection uses it to drop the IV and the padding after
+ * decrypting.
+ *
+ * An empty PacketBuffer doesn't have any memory.
+ */
+
+namespace SteamBot
+{
+    namespace Connection
+    {
+        class PacketBuffer
+        {
+        public:
+            class Storage;
+
+        private:
+            Storage* storage=nullptr;
+            std::span<std::byte> bytes;
+
+        private:
+            void release();
+
+        public:
+            PacketBuffer();
+            PacketBuffer(size_t);
+            ~PacketBuffer();
+
+            PacketBuffer(const PacketBuffer&);
+            PacketBuffer(PacketBuffer&&);
+
+            PacketBuffer& operator=(const PacketBuffer&);
+            PacketBuffer& operator=(PacketBuffer&&);
+
+        public:
+            std::byte* data() const
+            {
+                return bytes.data();
+            }
+
+            size_t size() const
+            {
+                return bytes.size();
+            }
+
+            bool empty() const
+            {
+                return bytes.empty();
+            }
+
+            operator std::span<std::byte>() const
+            {
+                return bytes;
+            }
+
+            operator std::span<const std::byte>() const
+            {
+                return bytes;
+            }
+
+        public:
+            void narrow(std::span<std::byte>);
+        };
+    }
+}
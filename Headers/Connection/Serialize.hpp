@@ -24,6 +24,7 @@
 #include <utility>
 #include <ranges>
 #include <concepts>
+#include <string_view>
 
 #include <boost/endian/conversion.hpp>
 
@@ -36,6 +37,29 @@
 
 #include "TypeName.hpp"
 
+/************************************************************************/
+/*
+ * Serializer and Deserializer log the content of protobuf messages
+ * with "debug" severity. The content is only rendered if debug
+ * messages are actually logged.
+ *
+ * setSampling() renders only every n-th message of a type (given by
+ * its full protobuf name); with 0, we only log the name and size.
+ * By default, this is done for CMsgMulti and for
+ * CMsgClientPICSProductInfoResponse, since they tend to be large.
+ */
+
+namespace SteamBot
+{
+    namespace Connection
+    {
+        namespace ProtobufLogging
+        {
+            void setSampling(std::string_view, unsigned int);
+        }
+    }
+}
+
 /************************************************************************/
 /*
  * This is a class to help serialize things to byte streams:
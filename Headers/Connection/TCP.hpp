@@ -22,6 +22,7 @@
 #include "Connection/Base.hpp"
 
 #include <vector>
+#include <array>
 
 /************************************************************************/
 /*
@@ -36,17 +37,21 @@ namespace SteamBot
         {
         private:
             boost::asio::ip::tcp::socket socket;
-            std::vector<MutableBytes::value_type> readBuffer;
+
+            // only used while writing, but we keep the memory
+            std::vector<std::array<std::byte, 8>> writeHeaders;
+            std::vector<boost::asio::const_buffer> writeBuffers;
 
         public:
-            TCP();
+            TCP(boost::asio::io_context&);
             virtual ~TCP();
 
         public:
             virtual void connect(const Endpoint&) override;
             virtual void disconnect() override;
-            virtual MutableBytes readPacket() override;
+            virtual PacketBuffer readPacket() override;
             virtual void writePacket(ConstBytes) override;
+            virtual void writePackets(std::span<const ConstBytes>) override;
 
             virtual void getLocalAddress(Endpoint&) const override;
 
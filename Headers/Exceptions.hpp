@@ -29,4 +29,5 @@
 namespace SteamBot
 {
     class OperationCancelledException { };
+    class TimeoutException { };
 }
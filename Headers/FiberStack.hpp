@@ -0,0 +1,88 @@
+/*
+ * This file is part of "Christians-Steam-Framework"
+ * Copyright (C) 2023- Christian Stieber
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 3, or (at
+ * your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; see the file LICENSE.  If not see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <boost/context/stack_context.hpp>
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/************************************************************************/
+/*
+ * A stack allocator for fibers, to be used instead of
+ * boost::fibers::protected_fixedsize_stack:
+ *
+ *    boost::fibers::fiber(std::allocator_arg, SteamBot::FiberStack("name"), ...)
+ *
+ * Stacks have a guard page, like the protected_fixedsize_stack, but
+ * they are kept in a process-wide pool when the fiber ends, so we
+ * don't mmap() and mprotect() new stacks all the time.
+ *
+ * The requested size is rounded up to the next size class. Stacks
+ * that are larger than the largest class are not pooled.
+ *
+ * The name is used for accounting: we track how many fibers were
+ * started under a name, and the largest amount of stack any of them
+ * has actually used (the "high-water mark"). Measuring the stack
+ * costs time, so we only do it for every n-th fiber of a name; the
+ * high-water mark is a sample, not a guarantee.
+ */
+
+namespace SteamBot
+{
+    class FiberStack
+    {
+    public:
+        class Statistics
+        {
+        public:
+            std::string name;
+            size_t stackSize=0;
+            uint64_t fibers=0;
+            size_t highWater=0;
+        };
+
+    public:
+        class Account;
+
+    private:
+        Account* account;
+        size_t size;
+        bool sampled=false;
+
+    public:
+        FiberStack(std::string_view, size_t=0);
+
+    public:
+        boost::context::stack_context allocate();
+        void deallocate(boost::context::stack_context&) noexcept;
+
+    public:
+        // Call these before starting fibers
+        static void setSizeClasses(std::vector<size_t>);
+        static void setMaxFree(size_t);
+        static void setSampleInterval(unsigned int);	// 0 to disable
+
+        static std::vector<Statistics> getStatistics();
+        static void logStatistics();
+    };
+}
@@ -25,7 +25,19 @@
 
 /************************************************************************/
 
+/*
+ * Converts a protobuf message into json, following the protobuf
+ * json mapping with field names as in the .proto, and enums as
+ * integers. Adds a "__type_name__" item with the message name.
+ *
+ * "full" also adds fields that are not set, with their default
+ * values.
+ *
+ * The json is built from the protobuf reflection, on the storage
+ * provided by the caller (or the default storage).
+ */
+
 namespace SteamBot
 {
-    boost::json::value toJson(const google::protobuf::Message&, bool full=false);
+    boost::json::value toJson(const google::protobuf::Message&, bool full=false, boost::json::storage_ptr={});
 }
@@ -0,0 +1,109 @@
+/*
+ * This file is part of "Christians-Steam-Framework"
+ * Copyright (C) 2023- Christian Stieber
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 3, or (at
+ * your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; see the file LICENSE.  If not see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "Exceptions.hpp"
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+/************************************************************************/
+/*
+ * A LatencyHistogram records how long operations of a kind take:
+ *
+ *    static SteamBot::LatencyHistogram histogram("name");
+ *    histogram.record(duration);
+ *
+ * or, to time a call:
+ *
+ *    auto result=SteamBot::LatencyHistogram("name").measure([&](){ ... });
+ *
+ * Histograms with the same name share their counters, so creating
+ * one is cheap and it doesn't have to be kept around. Calls that
+ * end in a TimeoutException are counted as timeouts.
+ *
+ * Buckets are powers of two in microseconds, so percentiles are
+ * reported as the upper bound of their bucket.
+ */
+
+namespace SteamBot
+{
+    class LatencyHistogram
+    {
+    public:
+        typedef std::chrono::steady_clock Clock;
+
+        class Statistics
+        {
+        public:
+            std::string name;
+            uint64_t count=0;
+            uint64_t timeouts=0;
+            std::chrono::microseconds p50{0};
+            std::chrono::microseconds p90{0};
+            std::chrono::microseconds p99{0};
+            std::chrono::microseconds max{0};
+        };
+
+    public:
+        class Account;
+
+    private:
+        Account* account;
+
+    public:
+        LatencyHistogram(std::string_view);
+
+    public:
+        void record(Clock::duration, bool timedOut=false);
+
+        template <typename FUNC> auto measure(FUNC&& func)
+        {
+            const auto start=Clock::now();
+            try
+            {
+                if constexpr (std::is_void_v<decltype(func())>)
+                {
+                    func();
+                    record(Clock::now()-start);
+                }
+                else
+                {
+                    auto result=func();
+                    record(Clock::now()-start);
+                    return result;
+                }
+            }
+            catch(const SteamBot::TimeoutException&)
+            {
+                record(Clock::now()-start, true);
+                throw;
+            }
+        }
+
+    public:
+        static std::vector<Statistics> getStatistics();
+        static void logStatistics();
+    };
+}
@@ -19,6 +19,10 @@
 
 #pragma once
 
+#include <boost/log/trivial.hpp>
+#include <boost/log/sources/severity_channel_logger.hpp>
+#include <boost/log/sources/record_ostream.hpp>
+
 /************************************************************************/
 
 namespace SteamBot
@@ -28,3 +32,43 @@ namespace SteamBot
         void init();
     }
 }
+
+/************************************************************************/
+/*
+ * Log records belong to a channel. BOOST_LOG_TRIVIAL() records are
+ * on the "General" channel; use STEAMBOT_LOG(channel, severity) to
+ * log on a different one.
+ *
+ * Messages below the severity of their channel are dropped.
+ * STEAMBOT_LOG() checks this before evaluating the stream expression,
+ * so expensive output is never rendered for dropped records; put it
+ * into an operator<< rather than producing it up front.
+ *
+ * The defaults are "debug" for General, and "info" for Connection
+ * (which renders every protobuf message on debug). At startup,
+ * init() reads the STEAMBOT_LOG environment variable, which looks
+ * like "info,connection=debug": a plain severity applies to all
+ * channels, "<channel>=<severity>" to just one.
+ */
+
+namespace SteamBot
+{
+    namespace Logging
+    {
+        enum class Channel : unsigned int { General, Connection };
+
+        void setSeverity(boost::log::trivial::severity_level);
+        void setSeverity(Channel, boost::log::trivial::severity_level);
+
+        bool isEnabled(Channel, boost::log::trivial::severity_level);
+
+        typedef boost::log::sources::severity_channel_logger_mt<boost::log::trivial::severity_level, Channel> Logger;
+        Logger& getLogger(Channel);
+    }
+}
+
+/************************************************************************/
+
+#define STEAMBOT_LOG(channel, severity)                                                                                      \
+    if (!SteamBot::Logging::isEnabled(SteamBot::Logging::Channel::channel, boost::log::trivial::severity)) {} else         \
+        BOOST_LOG_SEV(SteamBot::Logging::getLogger(SteamBot::Logging::Channel::channel), boost::log::trivial::severity)
@@ -20,6 +20,7 @@
 #pragma once
 
 #include "MiscIDs.hpp"
+#include "Client/Whiteboard.hpp"
 
 #include <unordered_map>
 #include <string>
@@ -100,6 +101,10 @@ namespace SteamBot
 
 /************************************************************************/
 
+template <> struct SteamBot::PublishSnapshot<SteamBot::Modules::BadgeData::Whiteboard::BadgeData::Ptr> : std::true_type { };
+
+/************************************************************************/
+
 namespace SteamBot
 {
     namespace Modules
@@ -119,6 +124,12 @@ namespace SteamBot
                     {
                     }
 
+                    // for QueuePolicy::coalesce()
+                    AppID coalesceKey() const
+                    {
+                        return appId;
+                    }
+
                 public:
                     static void update(AppID);
                 };
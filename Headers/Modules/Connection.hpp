@@ -22,6 +22,12 @@
 /************************************************************************/
 
 #include "Connection/Message.hpp"
+#include "Client/Waiter.hpp"
+#include "DestructMonitor.hpp"
+#include "JobID.hpp"
+
+#include <deque>
+#include <typeinfo>
 
 /************************************************************************/
 
@@ -114,3 +120,88 @@ namespace SteamBot
         }
     }
 }
+
+/************************************************************************/
+/*
+ * A JobWaiter<T> receives the T messages that are responses to a
+ * specific jobid, i.e. that have it as their jobid_target.
+ *
+ * While the JobWaiter exists, these messages go directly to it
+ * instead of the messageboard, so other fibers waiting for
+ * responses of the same type don't even see them. The connection
+ * module finds the JobWaiter with a hash lookup.
+ *
+ *    const SteamBot::JobID jobId;
+ *    auto response=waiter->createWaiter<JobWaiter<ResponseType>>(jobId);
+ *    ... send the request with jobId as jobid_source ...
+ *    waiter->wait();
+ *    if (auto message=response->fetch()) ...
+ *
+ * Create the JobWaiter before sending the request. There can only
+ * be one JobWaiter for a jobid; createWaiter() throws a
+ * std::logic_error for a second one.
+ */
+
+namespace SteamBot
+{
+    namespace Modules
+    {
+        namespace Connection
+        {
+            namespace Internal
+            {
+                class JobRouter;
+            }
+
+            class JobWaiterBase : public SteamBot::Waiter::ItemBase
+            {
+            public:
+                const uint64_t jobId;
+
+            private:
+                std::weak_ptr<Internal::JobRouter> router;
+                std::deque<std::shared_ptr<SteamBot::DestructMonitor>> responses;
+
+            protected:
+                JobWaiterBase(std::shared_ptr<SteamBot::WaiterBase>&&, const SteamBot::JobID&);
+
+                std::shared_ptr<SteamBot::DestructMonitor> fetchBase();
+
+            public:
+                virtual ~JobWaiterBase();
+
+                virtual bool isWoken() const override;
+                virtual void install(std::shared_ptr<ItemBase>) override;
+
+            public:
+                virtual bool accepts(const SteamBot::DestructMonitor&) const =0;
+                void deliver(std::shared_ptr<SteamBot::DestructMonitor>);
+            };
+
+            template <typename T> class JobWaiter : public JobWaiterBase
+            {
+            public:
+                typedef T value_type;	// makes createWaiter() install the handler for T
+
+            public:
+                JobWaiter(std::shared_ptr<SteamBot::WaiterBase> waiter_, const SteamBot::JobID& jobId_)
+                    : JobWaiterBase(std::move(waiter_), jobId_)
+                {
+                }
+
+                virtual ~JobWaiter() =default;
+
+            public:
+                virtual bool accepts(const SteamBot::DestructMonitor& message) const override
+                {
+                    return typeid(message)==typeid(T);
+                }
+
+                std::shared_ptr<const T> fetch()
+                {
+                    return std::static_pointer_cast<const T>(fetchBase());
+                }
+            };
+        }
+    }
+}
@@ -22,6 +22,8 @@
 #include "Client/Client.hpp"
 #include "DestructMonitor.hpp"
 
+#include <limits>
+
 /************************************************************************/
 
 namespace SteamBot
@@ -43,11 +45,15 @@ namespace SteamBot
                 protected:
                     static void add(SteamBot::Connection::Message::Type, std::unique_ptr<HandlerBase>&&);
 
-                private:
-                    virtual std::shared_ptr<SteamBot::DestructMonitor> send(SteamBot::Connection::Base::ConstBytes) const =0;
+                public:
+                    static constexpr uint64_t noJobId=std::numeric_limits<uint64_t>::max();
 
                 public:
-                    void handle(SteamBot::Connection::Base::ConstBytes) const;
+                    virtual std::shared_ptr<SteamBot::DestructMonitor> decode(SteamBot::Connection::Base::ConstBytes) const =0;
+                    virtual void send(std::shared_ptr<SteamBot::DestructMonitor>) const =0;
+
+                    // the jobid_target, or noJobId
+                    virtual uint64_t getJobTarget(const SteamBot::DestructMonitor&) const =0;
                 };
             }
         }
@@ -70,12 +76,27 @@ namespace SteamBot
                     Handler() =default;
                     virtual ~Handler() =default;
 
-                private:
-                    virtual std::shared_ptr<SteamBot::DestructMonitor> send(SteamBot::Connection::Base::ConstBytes bytes) const override
+                public:
+                    virtual std::shared_ptr<SteamBot::DestructMonitor> decode(SteamBot::Connection::Base::ConstBytes bytes) const override
+                    {
+                        return std::make_shared<T>(bytes);
+                    }
+
+                    virtual void send(std::shared_ptr<SteamBot::DestructMonitor> message) const override
+                    {
+                        SteamBot::Client::getClient().messageboard.send(std::static_pointer_cast<T>(std::move(message)));
+                    }
+
+                    virtual uint64_t getJobTarget(const SteamBot::DestructMonitor& message) const override
                     {
-                        auto message=std::make_shared<T>(bytes);
-                        SteamBot::Client::getClient().messageboard.send(message);
-                        return message;
+                        if constexpr (requires(const T& item) { item.header.proto.jobid_target(); })
+                        {
+                            return static_cast<const T&>(message).header.proto.jobid_target();
+                        }
+                        else
+                        {
+                            return noJobId;
+                        }
                     }
 
                 public:
@@ -45,6 +45,9 @@ namespace SteamBot
 /*
  * Retrieve copies of whiteboard elements from a client.
  *
+ * If all requested items are published as snapshots, they are read
+ * directly with getSnapshot<T>(); otherwise, this runs on the client.
+ *
  * ToDo: allow std::optional<T> as result type as well
  */
 
@@ -82,12 +85,28 @@ namespace SteamBot
                     }
                 }
 
+                template <typename T, typename... REST> void getSnapshots()
+                {
+                    std::get<T>(result)=whiteboard.getSnapshot<T>();
+                    if constexpr (sizeof...(REST)!=0)
+                    {
+                        getSnapshots<REST...>();
+                    }
+                }
+
             public:
                 static void perform(std::shared_ptr<SteamBot::Client> client, ResultType& result)
                 {
-                    SteamBot::Modules::Executor::execute(std::move(client), [&result](SteamBot::Client& client_) {
-                        GetWhiteboard(client_.whiteboard, result).get<ARGS...>();
-                    });
+                    if constexpr ((PublishSnapshot<ARGS>::value && ...))
+                    {
+                        GetWhiteboard(client->whiteboard, result).getSnapshots<ARGS...>();
+                    }
+                    else
+                    {
+                        SteamBot::Modules::Executor::execute(std::move(client), [&result](SteamBot::Client& client_) {
+                            GetWhiteboard(client_.whiteboard, result).get<ARGS...>();
+                        });
+                    }
                 }
             };
         }
@@ -20,6 +20,7 @@
 #pragma once
 
 #include "AssetKey.hpp"
+#include "Client/Whiteboard.hpp"
 
 #include <chrono>
 #include <vector>
@@ -101,3 +102,7 @@ namespace SteamBot
         std::shared_ptr<const Inventory> get();
     }
 }
+
+/************************************************************************/
+
+template <> struct SteamBot::PublishSnapshot<SteamBot::Inventory::Inventory::Ptr> : std::true_type { };
@@ -20,6 +20,7 @@
 #pragma once
 
 #include "MiscIDs.hpp"
+#include "Client/Whiteboard.hpp"
 #include "Printable.hpp"
 #include "Steam/LicenseType.hpp"
 #include "Steam/PaymentMethod.hpp"
@@ -109,6 +110,10 @@ namespace SteamBot
     }
 }
 
+/************************************************************************/
+
+template <> struct SteamBot::PublishSnapshot<SteamBot::Modules::LicenseList::Whiteboard::Licenses::Ptr> : std::true_type { };
+
 /************************************************************************/
 /*
  * The whiteboard will get the Licenses::Ptr before we send this
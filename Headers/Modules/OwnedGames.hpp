@@ -20,6 +20,7 @@
 #pragma once
 
 #include "MiscIDs.hpp"
+#include "Client/Whiteboard.hpp"
 
 #include <string>
 #include <unordered_map>
@@ -151,6 +152,10 @@ namespace SteamBot
     }
 }
 
+/************************************************************************/
+
+template <> struct SteamBot::PublishSnapshot<SteamBot::Modules::OwnedGames::Whiteboard::OwnedGames::Ptr> : std::true_type { };
+
 /************************************************************************/
 /*
  * Send this to request re-checking specific games
@@ -24,11 +24,16 @@
 #include "Modules/Login.hpp"
 #include "JobID.hpp"
 #include "ResultCode.hpp"
+#include "FiberStack.hpp"
+#include "LatencyHistogram.hpp"
+#include "Client/Deadline.hpp"
 
 #include <any>
 #include <any>
+#include <vector>
 #include <google/protobuf/service.h>
 #include <boost/callable_traits/args.hpp>
+#include <boost/fiber/future.hpp>
 #include <tuple>
 #include <type_traits>
 
@@ -40,6 +45,21 @@
  * "<Service>.<Method>#<Version>", example: "Player.GetGameBadgeLevels#1".
  *
  * An Error is thrown when the response as an eresult other than "OK".
+ *
+ * If a timeout is given, a TimeoutException is thrown if there's no
+ * response after that time. The current Deadline applies as well,
+ * and is inherited by the fibers of executeAsync().
+ *
+ * executeAsync() runs the call on a new fiber of the client, and
+ * returns a future for the response; errors are reported through
+ * the future. This lets you have several calls in flight at the
+ * same time.
+ *
+ * executeMany() performs a call for each of the requests, keeping
+ * up to "window" of them in flight, and returns a future for each
+ * request, in the same order as the requests. All futures are ready
+ * when it returns, so a failed call doesn't affect the others; each
+ * get() returns the response or throws the error of that call.
  */
 
 namespace SteamBot
@@ -53,10 +73,16 @@ namespace SteamBot
             class Error;
 
             template <typename RESPONSE, SteamBot::Connection::Message::Type TYPE=SteamBot::Connection::Message::Type::ServiceMethodCallFromClient, typename REQUEST>
-            std::shared_ptr<const ServiceMethodResponseMessage> executeFull(std::string_view, REQUEST&&);
+            std::shared_ptr<const ServiceMethodResponseMessage> executeFull(std::string_view, REQUEST&&, std::chrono::steady_clock::duration timeout=std::chrono::steady_clock::duration::zero());
+
+            template <typename RESPONSE, SteamBot::Connection::Message::Type TYPE=SteamBot::Connection::Message::Type::ServiceMethodCallFromClient, typename REQUEST>
+            std::shared_ptr<RESPONSE> execute(std::string_view, REQUEST&&, std::chrono::steady_clock::duration timeout=std::chrono::steady_clock::duration::zero());
+
+            template <typename RESPONSE, SteamBot::Connection::Message::Type TYPE=SteamBot::Connection::Message::Type::ServiceMethodCallFromClient, typename REQUEST>
+            boost::fibers::future<std::shared_ptr<RESPONSE>> executeAsync(std::string_view, REQUEST&&, std::chrono::steady_clock::duration timeout=std::chrono::steady_clock::duration::zero());
 
             template <typename RESPONSE, SteamBot::Connection::Message::Type TYPE=SteamBot::Connection::Message::Type::ServiceMethodCallFromClient, typename REQUEST>
-            std::shared_ptr<RESPONSE> execute(std::string_view, REQUEST&&);
+            std::vector<boost::fibers::future<std::shared_ptr<RESPONSE>>> executeMany(std::string_view, std::vector<REQUEST>, size_t window=4, std::chrono::steady_clock::duration timeout=std::chrono::steady_clock::duration::zero());
         }
     }
 }
@@ -157,7 +183,8 @@ public:
     static std::any deserialize(const SteamBot::JobID&, SteamBot::Connection::Deserializer&);
 
 protected:
-    std::shared_ptr<const ServiceMethodResponseMessage> waitForResponse() const;
+    std::shared_ptr<const ServiceMethodResponseMessage> sendAndWait(const std::shared_ptr<SteamBot::Modules::Connection::Messageboard::SendSteamMessage>&,
+                                                                    const SteamBot::Deadline&) const;
 };
 
 /************************************************************************/
@@ -256,7 +283,7 @@ public:
     virtual ~UnifiedMessage() =default;
 
 public:
-    std::shared_ptr<const ServiceMethodResponseMessage> execute(std::string_view method, REQUEST&& body)
+    std::shared_ptr<const ServiceMethodResponseMessage> execute(std::string_view method, REQUEST&& body, std::chrono::steady_clock::duration timeout)
     {
         typedef SteamBot::Modules::Connection::Messageboard::SendSteamMessage SendSteamMessage;
         std::shared_ptr<SendSteamMessage> sendSteamMessage;
@@ -268,13 +295,17 @@ public:
             sendSteamMessage=std::make_shared<SendSteamMessage>(std::move(message));
         }
 
+        const auto deadline=SteamBot::Deadline::current().earliest(SteamBot::Deadline(timeout));
+        SteamBot::LatencyHistogram histogram(std::string("UnifiedMessage ")+std::string(method));
+
         int counter=0;
         while (true)
         {
-            SteamBot::Client::getClient().messageboard.send(sendSteamMessage);
             try
             {
-                return waitForResponse();
+                return histogram.measure([&]() {
+                    return sendAndWait(sendSteamMessage, deadline);
+                });
             }
             catch(const SteamBot::Modules::UnifiedMessageClient::Error& exception)
             {
@@ -285,7 +316,7 @@ public:
                 }
 
                 // ToDo: maybe retrying isn't the solution?
-                if (counter>=10)
+                if (counter>=10 || deadline.remaining()<std::chrono::seconds(10))
                 {
                     throw;
                 }
@@ -312,17 +343,58 @@ private:
 
 template <typename RESPONSE, SteamBot::Connection::Message::Type TYPE, typename REQUEST>
 std::shared_ptr<const SteamBot::Modules::UnifiedMessageClient::ServiceMethodResponseMessage>
-SteamBot::Modules::UnifiedMessageClient::executeFull(std::string_view method, REQUEST&& body)
+SteamBot::Modules::UnifiedMessageClient::executeFull(std::string_view method, REQUEST&& body, std::chrono::steady_clock::duration timeout)
 {
     SteamBot::Modules::UnifiedMessageClient::Internal::UnifiedMessage<REQUEST,RESPONSE,TYPE> message;
-    return message.execute(method, std::move(body));
+    return message.execute(method, std::move(body), timeout);
 }
 
 /************************************************************************/
 
 template <typename RESPONSE, SteamBot::Connection::Message::Type TYPE, typename REQUEST>
 std::shared_ptr<RESPONSE>
-SteamBot::Modules::UnifiedMessageClient::execute(std::string_view method, REQUEST&& body)
+SteamBot::Modules::UnifiedMessageClient::execute(std::string_view method, REQUEST&& body, std::chrono::steady_clock::duration timeout)
+{
+    return executeFull<RESPONSE, TYPE, REQUEST>(method, std::move(body), timeout)->template getContent<RESPONSE>();
+}
+
+/************************************************************************/
+
+template <typename RESPONSE, SteamBot::Connection::Message::Type TYPE, typename REQUEST>
+boost::fibers::future<std::shared_ptr<RESPONSE>>
+SteamBot::Modules::UnifiedMessageClient::executeAsync(std::string_view method, REQUEST&& body, std::chrono::steady_clock::duration timeout)
 {
-    return executeFull<RESPONSE, TYPE, REQUEST>(method, std::move(body))->template getContent<RESPONSE>();
+    typedef std::remove_cvref_t<REQUEST> RequestType;
+    return boost::fibers::async(boost::fibers::launch::post, std::allocator_arg, SteamBot::FiberStack("UnifiedMessageClient::executeAsync"),
+                                [method=std::string(method), body=RequestType(std::forward<REQUEST>(body)), timeout]() mutable {
+                                    return execute<RESPONSE, TYPE, RequestType>(method, std::move(body), timeout);
+                                });
+}
+
+/************************************************************************/
+
+template <typename RESPONSE, SteamBot::Connection::Message::Type TYPE, typename REQUEST>
+std::vector<boost::fibers::future<std::shared_ptr<RESPONSE>>>
+SteamBot::Modules::UnifiedMessageClient::executeMany(std::string_view method, std::vector<REQUEST> requests, size_t window, std::chrono::steady_clock::duration timeout)
+{
+    assert(window>0);
+
+    std::vector<boost::fibers::future<std::shared_ptr<RESPONSE>>> responses;
+    responses.reserve(requests.size());
+
+    // Note: wait() doesn't throw, so we never leave calls running
+    size_t done=0;
+    for (auto& request : requests)
+    {
+        if (responses.size()-done>=window)
+        {
+            responses[done++].wait();
+        }
+        responses.push_back(executeAsync<RESPONSE, TYPE>(method, std::move(request), timeout));
+    }
+    while (done<responses.size())
+    {
+        responses[done++].wait();
+    }
+    return responses;
 }
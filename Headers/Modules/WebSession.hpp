@@ -103,6 +103,7 @@ namespace SteamBot
                 std::string body;
                 std::string referer;	// may be empty
                 boost::urls::url url;
+                SteamBot::HTTPClient::Query::Priority priority=SteamBot::HTTPClient::Query::Priority::Interactive;
 
             public:
                 // Note: this will trash the PostWithSession instance
@@ -23,19 +23,26 @@
 
 #include <boost/asio/buffer.hpp>
 
-#include <vector>
+#include <memory>
 #include <array>
 #include <span>
 
 /************************************************************************/
 /*
  * SteamKit2, NetFilterEncryption.cs, NetFilterEncryption
+ *
+ * An instance is the crypto session of one connection: it keeps the
+ * cipher contexts set up with the session key, and reuses them for
+ * all packets. Since the contexts carry state, a session must only
+ * be used by one thread at a time.
  */
 
 namespace SteamBot
 {
     namespace OpenSSL
     {
+        class CipherContext;
+
         class AESCryptoBase
         {
         public:
@@ -49,23 +56,31 @@ namespace SteamBot
             typedef std::array<std::byte, 16> IvType;
 
         private:
-            const KeyType key;
+            const std::unique_ptr<CipherContext> encryptIV;
+            const std::unique_ptr<CipherContext> encryptPayload;
+            const std::unique_ptr<CipherContext> decryptIV;
+            const std::unique_ptr<CipherContext> decryptPayload;
 
         public:
-            AESCryptoBase(const KeyType& myKey)
-                : key(myKey)
+            AESCryptoBase(const KeyType&);
+            virtual ~AESCryptoBase();
+
+        public:
+            // the output buffer size that encrypt() needs: the iv, plus the padded payload
+            static constexpr size_t getEncryptedSize(size_t size)
             {
+                return (size+std::tuple_size_v<IvType>+16)&~static_cast<size_t>(0x0f);
             }
 
-            virtual ~AESCryptoBase() =default;
-
         protected:
-            std::vector<std::byte> encryptWithIV(const std::span<const std::byte>&, const IvType&) const;
-            std::vector<std::byte> decryptWithIV(const std::span<const std::byte>&, IvType&) const;
+            size_t encryptWithIV(const std::span<const std::byte>&, const IvType&, const std::span<std::byte>&) const;
+            std::span<std::byte> decryptWithIV(const std::span<std::byte>&, IvType&) const;
 
         public:
-            virtual std::vector<std::byte> encrypt(const std::span<const std::byte>&) const =0;
-            virtual std::vector<std::byte> decrypt(const std::span<const std::byte>&) const =0;
+            // encrypt() returns the number of bytes written to the output buffer
+            // decrypt() works in place, and returns the plaintext part of the buffer
+            virtual size_t encrypt(const std::span<const std::byte>&, const std::span<std::byte>&) const =0;
+            virtual std::span<std::byte> decrypt(const std::span<std::byte>&) const =0;
         };
     }
 }
@@ -92,8 +107,8 @@ namespace SteamBot
             virtual ~AESCrypto() =default;
 
         public:
-            virtual std::vector<std::byte> encrypt(const std::span<const std::byte>&) const override;
-            virtual std::vector<std::byte> decrypt(const std::span<const std::byte>&) const override;
+            virtual size_t encrypt(const std::span<const std::byte>&, const std::span<std::byte>&) const override;
+            virtual std::span<std::byte> decrypt(const std::span<std::byte>&) const override;
         };
     }
 }
@@ -145,8 +160,8 @@ namespace SteamBot
             bool isValidIV(const std::span<const std::byte>&, const IvType&) const;
 
         public:
-            virtual std::vector<std::byte> encrypt(const std::span<const std::byte>&) const override;
-            virtual std::vector<std::byte> decrypt(const std::span<const std::byte>&) const override;
+            virtual size_t encrypt(const std::span<const std::byte>&, const std::span<std::byte>&) const override;
+            virtual std::span<std::byte> decrypt(const std::span<std::byte>&) const override;
         };
     }
 }
@@ -35,6 +35,47 @@ typedef SteamBot::Asio Asio;
 
 /************************************************************************/
 
+class SteamBot::Asio::Thread
+{
+public:
+    const Shard shard;
+    std::shared_ptr<boost::asio::io_context> ioContext;
+    std::thread thread;
+
+public:
+    Thread(Shard shard_)
+        : shard(shard_), ioContext(std::make_shared<boost::asio::io_context>(1))
+    {
+        thread=std::thread([this](){
+            BOOST_LOG_TRIVIAL(debug) << "Asio: running thread for shard " << shard;
+            boost::fibers::asio::setSchedulingAlgorithm(ioContext);
+            auto work=boost::asio::make_work_guard(ioContext);
+            if (shard==mainShard)
+            {
+                handleSignals(*ioContext);
+            }
+            ioContext->run();
+            BOOST_LOG_TRIVIAL(debug) << "Asio: exiting thread for shard " << shard;
+        });
+    }
+};
+
+/************************************************************************/
+
+static unsigned int threadCount=0;
+
+/************************************************************************/
+/*
+ * Must be called before anything uses Asio. 0 means "number of cores".
+ */
+
+void Asio::setThreadCount(unsigned int count)
+{
+    threadCount=count;
+}
+
+/************************************************************************/
+
 Asio::~Asio()
 {
     assert(false);
@@ -43,16 +84,24 @@ Asio::~Asio()
 /************************************************************************/
 
 Asio::Asio()
-    : ioContext(std::make_shared<boost::asio::io_context>())
 {
-    thread=std::thread([this](){
-        BOOST_LOG_TRIVIAL(debug) << "Asio: running thread";
-        boost::fibers::asio::setSchedulingAlgorithm(ioContext);
-        auto work=boost::asio::make_work_guard(ioContext);
-        handleSignals(*ioContext);
-        ioContext->run();
-        BOOST_LOG_TRIVIAL(debug) << "Asio: exiting thread";
-    });
+    unsigned int count=threadCount;
+    if (count==0)
+    {
+        count=std::thread::hardware_concurrency();
+        if (count==0)
+        {
+            count=1;
+        }
+    }
+
+    BOOST_LOG_TRIVIAL(info) << "Asio: using " << count << " threads";
+
+    threads.reserve(count);
+    for (Shard shard=0; shard<count; shard++)
+    {
+        threads.push_back(std::make_unique<Thread>(shard));
+    }
 }
 
 /************************************************************************/
@@ -65,17 +114,28 @@ Asio& Asio::get()
 
 /************************************************************************/
 /*
- * Check whether we are on the asio thread
+ * Returns the next shard, round-robin
+ */
+
+Asio::Shard Asio::pickShard()
+{
+    auto& asio=get();
+    return asio.nextShard++%asio.threads.size();
+}
+
+/************************************************************************/
+/*
+ * Check whether we are on the asio thread for the shard
  */
 
-bool Asio::isThread()
+bool Asio::isThread(Shard shard)
 {
-    return get().thread.get_id()==std::this_thread::get_id();
+    return get().threads.at(shard)->thread.get_id()==std::this_thread::get_id();
 }
 
 /************************************************************************/
 
-boost::asio::io_context& Asio::getIoContext()
+boost::asio::io_context& Asio::getIoContext(Shard shard)
 {
-    return *(get().ioContext);
+    return *(get().threads.at(shard)->ioContext);
 }
@@ -19,21 +19,50 @@
 
 #include "./BasicQuery.hpp"
 
+#include <boost/asio/ssl/error.hpp>
+
 #include <boost/beast/version.hpp>
 #include <boost/beast/http/write.hpp>
 #include <boost/beast/http/read.hpp>
+#include <boost/beast/core/error.hpp>
+#include <boost/beast/http/parser.hpp>
+#include <boost/beast/http/empty_body.hpp>
+#include <boost/beast/http/buffer_body.hpp>
+
+#include <boost/json/stream_parser.hpp>
+#include <boost/json/monotonic_resource.hpp>
+
+#include <array>
+#include <optional>
 
 /************************************************************************/
 /*
  * This is the basic HTTPClient handling to execute a single query;
- * it's expected to run on the Asio thread already, and does not
- * perform any rate limiting.
+ * it's created on the main Asio thread, but does its networking on
+ * the shard it was assigned to. It does not perform any rate
+ * limiting.
+ *
+ * Connections are taken from the ConnectionPool if possible, and
+ * given back to it if the server lets us keep them.
+ *
+ * Host names are resolved through the Asio::Resolver cache.
+ *
+ * The deadline of the query is applied to every step: a timer stops
+ * us from waiting for the resolver, and the stream operations use
+ * the tcp_stream timeout, so they fail with a timeout error.
+ *
+ * For "streamJson" queries, we read the header first. The body of a
+ * 200 response is then read in chunks, and every chunk goes straight
+ * into the JSON parser; other responses are read as usual.
  */
 
 /************************************************************************/
 
 typedef SteamBot::HTTPClient::Internal::BasicQuery BasicQuery;
 
+namespace ConnectionPool=SteamBot::HTTPClient::Internal::ConnectionPool;
+namespace TLSSessionCache=SteamBot::HTTPClient::Internal::TLSSessionCache;
+
 namespace http=boost::beast::http;
 
 /************************************************************************/
@@ -45,12 +74,37 @@ static inline unsigned long getSslErrorCode(const boost::system::error_code& err
     return static_cast<unsigned long>(errorValue);
 }
 
+/************************************************************************/
+/*
+ * The monotonic resource for a streamed JSON response starts with
+ * the size of the body, if we know it.
+ */
+
+static constexpr size_t defaultJsonSize=64*1024;
+static constexpr size_t maxJsonSize=16*1024*1024;
+
+/************************************************************************/
+
+class BasicQuery::JsonReader
+{
+public:
+    http::response_parser<http::empty_body> headerParser;
+    std::optional<http::response_parser<http::buffer_body>> bodyParser;
+    std::optional<http::response_parser<http::dynamic_body>> responseParser;
+
+    boost::json::stream_parser parser;
+    std::array<char, 16*1024> buffer;
+    size_t bytes=0;
+};
+
 /************************************************************************/
 
 boost::asio::ssl::context& BasicQuery::getSslContext()
 {
     static boost::asio::ssl::context& sslContext=*([](){
-        auto context=new boost::asio::ssl::context(boost::asio::ssl::context::tlsv12_client);
+        auto context=new boost::asio::ssl::context(boost::asio::ssl::context::tls_client);
+        SSL_CTX_set_min_proto_version(context->native_handle(), TLS1_2_VERSION);
+        TLSSessionCache::install(*context);
 #ifndef _WIN32
         context->set_default_verify_paths();
         context->set_verify_mode(boost::asio::ssl::verify_peer | boost::asio::ssl::verify_fail_if_no_peer_cert);
@@ -69,7 +123,8 @@ boost::asio::ssl::context& BasicQuery::getSslContext()
 BasicQuery::BasicQuery(HTTPClient::Query& query_, Callback&& callback_)
     : query(&query_),
       callback(std::move(callback_)),
-      resolver(SteamBot::Asio::getIoContext())
+      shard(ConnectionPool::pickShard(query_.url)),
+      resolveTimer(SteamBot::Asio::getIoContext(shard))
 {
     assert(SteamBot::Asio::isThread());
     BOOST_LOG_TRIVIAL(debug) << "constructed query to " << query->url;
@@ -112,7 +167,7 @@ static void printSslError(const boost::system::error_code& error)
 
 void BasicQuery::complete(const ErrorCode& error)
 {
-    assert(SteamBot::Asio::isThread());
+    assert(SteamBot::Asio::isThread(shard));
 
     if (error)
     {
@@ -121,7 +176,9 @@ void BasicQuery::complete(const ErrorCode& error)
     }
 
     query->error=error;
-    callback(*this);
+    SteamBot::Asio::post("BasicQuery::complete", [self=shared_from_this()]() {
+        self->callback(*self);
+    });
 }
 
 /************************************************************************/
@@ -140,7 +197,7 @@ void BasicQuery::close()
 
     public:
         Shutdown(BasicQuery& basicQuery)
-            : timer(SteamBot::Asio::getIoContext(), std::chrono::seconds(2)),
+            : timer(SteamBot::Asio::getIoContext(basicQuery.shard), std::chrono::seconds(2)),
               stream(std::move(basicQuery.stream)),
               url(basicQuery.query->url)
         {
@@ -171,10 +228,74 @@ void BasicQuery::close()
 
 /************************************************************************/
 
-void BasicQuery::read_completed(const ErrorCode& error, size_t)
+void BasicQuery::applyDeadline()
+{
+    if (query->deadline.isSet())
+    {
+        boost::beast::get_lowest_layer(*stream).expires_at(query->deadline.get());
+    }
+    else
+    {
+        boost::beast::get_lowest_layer(*stream).expires_never();
+    }
+}
+
+/************************************************************************/
+/*
+ * If a pooled connection fails before we got a response, the server
+ * has probably closed it while it was idle. We try again once, on
+ * a new connection.
+ *
+ * Once the request has been sent, the server might have processed
+ * it already. We only send it again if it's a GET or HEAD, and not
+ * a single byte of the response has arrived.
+ */
+
+bool BasicQuery::retry(const ErrorCode& error, bool requestSent)
+{
+    if (!reused || query->deadline.expired())
+    {
+        return false;
+    }
+
+    if (requestSent)
+    {
+        const auto method=query->request.method();
+        if (method!=http::verb::get && method!=http::verb::head)
+        {
+            return false;
+        }
+    }
+
+    if (error!=boost::beast::http::error::end_of_stream &&
+        error!=boost::asio::error::eof &&
+        error!=boost::asio::error::connection_reset &&
+        error!=boost::asio::error::connection_aborted &&
+        error!=boost::asio::error::broken_pipe &&
+        error!=boost::asio::ssl::error::stream_truncated)
+    {
+        return false;
+    }
+
+    BOOST_LOG_TRIVIAL(info) << "pooled connection for query " << query->url << " has failed with " << error.message() << "; retrying on a new connection";
+
+    ConnectionPool::stale();
+    reused=false;
+    stream.reset();
+    resolve();
+    return true;
+}
+
+/************************************************************************/
+
+void BasicQuery::read_completed(const ErrorCode& error, size_t bytes)
 {
     if (error)
     {
+        if (bytes==0 && query->responseBuffer.size()==0 && retry(error, true))
+        {
+            return;
+        }
         return complete(error);
     }
 
@@ -183,7 +304,14 @@ void BasicQuery::read_completed(const ErrorCode& error, size_t)
                             << "\" has received a " << query->response.body().size()
                             << " byte response with code \"" << query->response.result() << "\"";
 
-    close();
+    if (query->response.keep_alive())
+    {
+        ConnectionPool::release(shard, host, port, std::move(stream));
+    }
+    else
+    {
+        close();
+    }
 
     {
         std::ostringstream output;
@@ -205,12 +333,117 @@ void BasicQuery::read_completed(const ErrorCode& error, size_t)
     complete(ErrorCode());
 }
 
+/************************************************************************/
+/*
+ * Completion of the non-200 response of a "streamJson" query
+ */
+
+void BasicQuery::body_completed(const ErrorCode& error, size_t bytes)
+{
+    if (error)
+    {
+        // we have the header, so this can't be retried
+        jsonReader.reset();
+        return complete(error);
+    }
+
+    query->response=jsonReader->responseParser->release();
+    jsonReader.reset();
+    read_completed(error, bytes);
+}
+
+/************************************************************************/
+
+void BasicQuery::json_completed(const ErrorCode& error_, size_t)
+{
+    ErrorCode error=error_;
+    if (error==http::error::need_buffer)
+    {
+        error=ErrorCode();
+    }
+
+    if (!error)
+    {
+        auto& parser=*(jsonReader->bodyParser);
+        const size_t bytes=jsonReader->buffer.size()-parser.get().body().size;
+        jsonReader->bytes+=bytes;
+        jsonReader->parser.write(jsonReader->buffer.data(), bytes, error);
+
+        if (!error)
+        {
+            if (!parser.is_done())
+            {
+                return readJson();
+            }
+
+            jsonReader->parser.finish(error);
+            if (!error)
+            {
+                BOOST_LOG_TRIVIAL(debug) << "HTTPClient: parsed " << jsonReader->bytes << " bytes of JSON for \"" << query->url << "\"";
+                query->json=jsonReader->parser.release();
+                query->response.base()=parser.get().base();
+            }
+        }
+    }
+
+    const auto bytes=jsonReader->bytes;
+    jsonReader.reset();
+    if (error)
+    {
+        // we have the header, so this can't be retried
+        return complete(error);
+    }
+    read_completed(error, bytes);
+}
+
+/************************************************************************/
+
+void BasicQuery::readJson()
+{
+    auto& body=jsonReader->bodyParser->get().body();
+    body.data=jsonReader->buffer.data();
+    body.size=jsonReader->buffer.size();
+    http::async_read(*stream, query->responseBuffer, *(jsonReader->bodyParser), std::bind_front(&BasicQuery::json_completed, shared_from_this()));
+}
+
+/************************************************************************/
+
+void BasicQuery::header_completed(const ErrorCode& error, size_t bytes)
+{
+    if (error)
+    {
+        jsonReader.reset();
+        return read_completed(error, bytes);
+    }
+
+    if (jsonReader->headerParser.get().result()==http::status::ok)
+    {
+        size_t size=defaultJsonSize;
+        if (auto length=jsonReader->headerParser.content_length())
+        {
+            size=std::min<size_t>(std::max<size_t>(*length, 1), maxJsonSize);
+        }
+        jsonReader->parser.reset(boost::json::make_shared_resource<boost::json::monotonic_resource>(size));
+        jsonReader->bodyParser.emplace(std::move(jsonReader->headerParser));
+        readJson();
+    }
+    else
+    {
+        jsonReader->responseParser.emplace(std::move(jsonReader->headerParser));
+        http::async_read(*stream, query->responseBuffer, *(jsonReader->responseParser), std::bind_front(&BasicQuery::body_completed, shared_from_this()));
+    }
+}
+
 /************************************************************************/
 
 void BasicQuery::write_completed(const ErrorCode& error, size_t bytes)
 {
     if (error)
     {
+        if (retry(error, false))
+        {
+            return;
+        }
         return complete(error);
     }
 
@@ -219,7 +452,16 @@ void BasicQuery::write_completed(const ErrorCode& error, size_t bytes)
     // Receive the HTTP response
     query->responseBuffer=decltype(query->responseBuffer)();
     query->response=decltype(query->response)();
-    boost::beast::http::async_read(*stream, query->responseBuffer, query->response, std::bind_front(&BasicQuery::read_completed, shared_from_this()));
+    applyDeadline();
+    if (query->streamJson)
+    {
+        jsonReader=std::make_unique<JsonReader>();
+        http::async_read_header(*stream, query->responseBuffer, jsonReader->headerParser, std::bind_front(&BasicQuery::header_completed, shared_from_this()));
+    }
+    else
+    {
+        http::async_read(*stream, query->responseBuffer, query->response, std::bind_front(&BasicQuery::read_completed, shared_from_this()));
+    }
 }
 
 /************************************************************************/
@@ -232,10 +474,34 @@ void BasicQuery::handshake_completed(const ErrorCode& error)
     }
 
     BOOST_LOG_TRIVIAL(debug) << "BasicQuery::handshake_completed for query \"" << query->url << "\"";
+    TLSSessionCache::handshakeCompleted(stream->native_handle());
 
+    sendRequest();
+}
+
+/************************************************************************/
+
+void BasicQuery::sendRequest()
+{
+    if (!prepared)
+    {
+        prepared=true;
+        prepare();
+    }
+
+    // Send the HTTP request to the remote host
+    applyDeadline();
+    http::async_write(*stream, query->request, std::bind_front(&BasicQuery::write_completed, shared_from_this()));
+}
+
+/************************************************************************/
+
+void BasicQuery::prepare()
+{
     query->request.target(query->url.encoded_target());
     query->request.set(http::field::host, host);
     query->request.set(http::field::user_agent, BOOST_BEAST_VERSION_STRING);
+    query->request.set(http::field::connection, "keep-alive");
     if (query->request[http::field::accept_language]=="")
     {
         query->request.set(http::field::accept_language, "en-US; q=0.9, en; q=0.8");
@@ -266,14 +532,11 @@ void BasicQuery::handshake_completed(const ErrorCode& error)
         }
         BOOST_LOG_TRIVIAL(debug) << output.view();
     }
-
-    // Send the HTTP request to the remote host
-    http::async_write(*stream, query->request, std::bind_front(&BasicQuery::write_completed, shared_from_this()));
 }
 
 /************************************************************************/
 
-void BasicQuery::connect_completed(const ErrorCode& error, const Resolver::endpoint_type& endpoint)
+void BasicQuery::connect_completed(const ErrorCode& error, const boost::asio::ip::tcp::endpoint& endpoint)
 {
     if (error)
     {
@@ -281,16 +544,26 @@ void BasicQuery::connect_completed(const ErrorCode& error, const Resolver::endpo
     }
 
     BOOST_LOG_TRIVIAL(debug) << "BasicQuery::connect_completed for query \"" << query->url << "\" with endpoint " << endpoint;
+    ConnectionPool::created();
 
     // Perform the SSL handshake
     // ToDo: for some reason, certificate problems don't seem to matter...
+    applyDeadline();
     stream->async_handshake(boost::asio::ssl::stream_base::client, std::bind_front(&BasicQuery::handshake_completed, shared_from_this()));
 }
 
 /************************************************************************/
 
-void BasicQuery::resolve_completed(const ErrorCode& error, Resolver::results_type resolverResults)
+void BasicQuery::resolve_completed(const ErrorCode& error, Resolver::Results resolverResults)
 {
+    // the deadline might have expired while we were waiting
+    if (!resolving)
+    {
+        return;
+    }
+    resolving=false;
+    resolveTimer.cancel();
+
     if (error)
     {
         return complete(error);
@@ -299,27 +572,63 @@ void BasicQuery::resolve_completed(const ErrorCode& error, Resolver::results_typ
     BOOST_LOG_TRIVIAL(debug) << "BasicQuery::resolve_completed for query \"" << query->url << "\"";
 
     // Setup the SSL stream
-    stream=std::make_unique<decltype(stream)::element_type>(SteamBot::Asio::getIoContext(), getSslContext());
+    stream=std::make_unique<decltype(stream)::element_type>(SteamBot::Asio::getIoContext(shard), getSslContext());
     if (!SSL_set_tlsext_host_name(stream->native_handle(), host.c_str()))
     {
         const boost::beast::error_code ec{static_cast<int>(::ERR_get_error()), boost::asio::error::get_ssl_category()};
         return complete(error);
     }
+    TLSSessionCache::apply(stream->native_handle(), host);
 
     // Make the connection on an IP address we got from the lookup
+    applyDeadline();
     boost::beast::get_lowest_layer(*stream).async_connect(resolverResults, std::bind_front(&BasicQuery::connect_completed, shared_from_this()));
 }
 
 /************************************************************************/
 
+void BasicQuery::resolve()
+{
+    if (query->deadline.isSet())
+    {
+        resolveTimer.expires_at(query->deadline.get());
+        resolveTimer.async_wait([self=shared_from_this()](const ErrorCode& error) {
+            if (!error && self->resolving)
+            {
+                self->resolving=false;
+                self->complete(boost::beast::error::timeout);
+            }
+        });
+    }
+    resolving=true;
+    Resolver::resolve(shard, host, port, std::bind_front(&BasicQuery::resolve_completed, shared_from_this()));
+}
+
+/************************************************************************/
+
 void BasicQuery::perform()
 {
-    BOOST_LOG_TRIVIAL(info) << "BasicQuery::perform query \"" << query->url << "\"";
+    assert(SteamBot::Asio::isThread(shard));
+    BOOST_LOG_TRIVIAL(info) << "BasicQuery::perform query \"" << query->url << "\" on Asio shard " << shard;
 
-    std::string_view port=query->url.port();
-    if (port.empty()) port="443";
+    if (query->deadline.expired())
+    {
+        return complete(boost::beast::error::timeout);
+    }
 
-    // Look up the host name
     host=query->url.host();
-    resolver.async_resolve(host, port, std::bind_front(&BasicQuery::resolve_completed, shared_from_this()));
+    port=query->url.port();
+    if (port.empty()) port="443";
+    prepared=false;
+
+    if ((stream=ConnectionPool::acquire(shard, host, port)))
+    {
+        reused=true;
+        sendRequest();
+    }
+    else
+    {
+        reused=false;
+        resolve();
+    }
 }
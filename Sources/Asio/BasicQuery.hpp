@@ -20,9 +20,11 @@
 #pragma once
 
 #include "Asio/Asio.hpp"
+#include "Asio/Resolver.hpp"
 #include "Asio/HTTPClient.hpp"
 
 #include <boost/asio/ip/tcp.hpp>
+#include <boost/asio/steady_timer.hpp>
 #include <boost/asio/ssl/context.hpp>
 #include <boost/beast/ssl/ssl_stream.hpp>
 #include <boost/beast/core/tcp_stream.hpp>
@@ -41,21 +43,37 @@ namespace SteamBot
                 typedef std::function<void(BasicQuery&)> Callback;
 
             private:
-                typedef boost::asio::ip::tcp::resolver Resolver;
+                typedef SteamBot::Asio::Resolver Resolver;
                 typedef boost::system::error_code ErrorCode;
 
             public:
                 HTTPClient::Query* query;
                 Callback callback;
 
+                // the query itself runs on this shard; the callback
+                // is called on the main Asio thread
+                const SteamBot::Asio::Shard shard;
+
             private:
                 // we need 0-termination for SSL_set_tlsext_host_name()
                 std::string host;
+                std::string port;
+
+                // the stream came from the connection pool
+                bool reused=false;
+
+                // the request headers have been filled in
+                bool prepared=false;
 
             private:
-                Resolver resolver;
+                boost::asio::steady_timer resolveTimer;
+                bool resolving=false;
                 std::unique_ptr<boost::beast::ssl_stream<boost::beast::tcp_stream>> stream;
 
+                // for "streamJson" queries
+                class JsonReader;
+                std::unique_ptr<JsonReader> jsonReader;
+
             private:
                 static boost::asio::ssl::context& getSslContext();
 
@@ -65,13 +83,23 @@ namespace SteamBot
 
             private:
                 void close();
+                void applyDeadline();
+                bool retry(const ErrorCode&, bool requestSent);
+                void resolve();
+                void prepare();
+                void sendRequest();
                 void complete(const ErrorCode&);
 
+                void readJson();
+
                 void read_completed(const ErrorCode&, size_t);
+                void header_completed(const ErrorCode&, size_t);
+                void json_completed(const ErrorCode&, size_t);
+                void body_completed(const ErrorCode&, size_t);
                 void write_completed(const ErrorCode&, size_t);
                 void handshake_completed(const ErrorCode&);
-                void connect_completed(const ErrorCode&, const Resolver::endpoint_type&);
-                void resolve_completed(const ErrorCode&, Resolver::results_type);
+                void connect_completed(const ErrorCode&, const boost::asio::ip::tcp::endpoint&);
+                void resolve_completed(const ErrorCode&, Resolver::Results);
 
             public:
                 void perform();
@@ -92,3 +120,57 @@ namespace SteamBot
         }
     }
 }
+
+/************************************************************************/
+/*
+ * The connection pool, see HTTPClient::ConnectionPool.
+ *
+ * Connections are bound to the shard they were made on, so
+ * pickShard() prefers a shard that has an idle connection to the
+ * host. acquire() and release() must be called on the shard.
+ */
+
+namespace SteamBot
+{
+    namespace HTTPClient
+    {
+        namespace Internal
+        {
+            namespace ConnectionPool
+            {
+                typedef boost::beast::ssl_stream<boost::beast::tcp_stream> Stream;
+
+                SteamBot::Asio::Shard pickShard(const boost::urls::url&);
+                std::unique_ptr<Stream> acquire(SteamBot::Asio::Shard, std::string_view host, std::string_view port);
+                void release(SteamBot::Asio::Shard, std::string_view host, std::string_view port, std::unique_ptr<Stream>);
+                void created();
+                void stale();
+            }
+        }
+    }
+}
+
+/************************************************************************/
+/*
+ * The TLS session cache, see HTTPClient::TLSSessionCache.
+ *
+ * install() sets up the SSL context. Call apply() after setting
+ * the SNI host name, and handshakeCompleted() after a successful
+ * handshake.
+ */
+
+namespace SteamBot
+{
+    namespace HTTPClient
+    {
+        namespace Internal
+        {
+            namespace TLSSessionCache
+            {
+                void install(boost::asio::ssl::context&);
+                void apply(SSL*, const std::string& host);
+                void handshakeCompleted(SSL*);
+            }
+        }
+    }
+}
@@ -55,6 +55,9 @@ static bool checkRedirect(SteamBot::HTTPClient::Query& query)
 /*
  * This executes a BasicQuery, and handles "redirect" status code in
  * the reponse.
+ *
+ * Call this on the main Asio thread; the query will be moved to its
+ * shard, and the callback comes back to the main thread.
  */
 
 void SteamBot::HTTPClient::Internal::performWithRedirect(std::shared_ptr<BasicQuery> query)
@@ -71,5 +74,8 @@ void SteamBot::HTTPClient::Internal::performWithRedirect(std::shared_ptr<BasicQu
             originalCallback(basicQuery);
         }
     };
-    query->perform();
+    const auto shard=query->shard;
+    SteamBot::Asio::post(shard, "performWithRedirect", [query=std::move(query)]() {
+        query->perform();
+    });
 }
@@ -0,0 +1,360 @@
+/*
+ * This file is part of "Christians-Steam-Framework"
+ * Copyright (C) 2023- Christian Stieber
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 3, or (at
+ * your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; see the file LICENSE.  If not see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#include "./BasicQuery.hpp"
+
+#include <boost/asio/steady_timer.hpp>
+
+#include <atomic>
+#include <deque>
+#include <map>
+#include <mutex>
+
+/************************************************************************/
+/*
+ * The pool is shared by all shards, so it's protected by a mutex;
+ * but each connection is only ever touched on its own shard.
+ *
+ * While a connection is idle, we wait for it to become readable:
+ * a keep-alive connection shouldn't receive anything until we send
+ * the next request, so this means the server has closed it (or is
+ * talking nonsense). Either way, it's dropped.
+ */
+
+typedef SteamBot::HTTPClient::ConnectionPool ConnectionPool;
+typedef SteamBot::HTTPClient::Internal::ConnectionPool::Stream Stream;
+
+/************************************************************************/
+
+namespace
+{
+    class Pool
+    {
+    private:
+        class Idle
+        {
+        public:
+            uint64_t id;
+            SteamBot::Asio::Shard shard;
+            std::unique_ptr<Stream> stream;
+            std::shared_ptr<boost::asio::steady_timer> timer;
+        };
+
+    private:
+        std::mutex mutex;
+        std::map<std::string, std::deque<Idle>, std::less<>> idle;
+        size_t idleCount=0;
+        uint64_t nextId=0;
+
+    public:
+        std::atomic<size_t> maxPerHost{4};
+        std::atomic<size_t> maxTotal{64};
+        std::atomic<std::chrono::steady_clock::duration> idleTimeout{std::chrono::seconds(30)};
+
+        std::atomic<uint64_t> created{0};
+        std::atomic<uint64_t> reused{0};
+        std::atomic<uint64_t> stale{0};
+
+    private:
+        Pool() =default;
+
+    public:
+        static Pool& get()
+        {
+            static Pool& pool=*new Pool;
+            return pool;
+        }
+
+    private:
+        static std::string makeKey(std::string_view host, std::string_view port)
+        {
+            std::string key(host);
+            key.push_back(':');
+            key.append(port);
+            return key;
+        }
+
+        static void close(std::unique_ptr<Stream> stream)
+        {
+            boost::system::error_code error;
+            boost::beast::get_lowest_layer(*stream).socket().close(error);
+        }
+
+        /*
+         * A connection that has data to read, or an error, can't be
+         * used for the next request
+         */
+        static bool isHealthy(Stream& stream)
+        {
+            auto& socket=boost::beast::get_lowest_layer(stream).socket();
+            if (!socket.is_open())
+            {
+                return false;
+            }
+            boost::system::error_code error;
+            auto available=socket.available(error);
+            return !error && available==0;
+        }
+
+        // Call with the mutex locked
+        std::unique_ptr<Stream> remove(const std::string& key, uint64_t id)
+        {
+            auto iterator=idle.find(key);
+            if (iterator!=idle.end())
+            {
+                auto& list=iterator->second;
+                for (auto item=list.begin(); item!=list.end(); ++item)
+                {
+                    if (item->id==id)
+                    {
+                        auto stream=std::move(item->stream);
+                        list.erase(item);
+                        if (list.empty())
+                        {
+                            idle.erase(iterator);
+                        }
+                        idleCount--;
+                        return stream;
+                    }
+                }
+            }
+            return nullptr;
+        }
+
+        void drop(const std::string& key, uint64_t id, const char* reason)
+        {
+            std::unique_ptr<Stream> stream;
+            {
+                std::lock_guard<decltype(mutex)> lock(mutex);
+                stream=remove(key, id);
+            }
+            if (stream)
+            {
+                BOOST_LOG_TRIVIAL(debug) << "ConnectionPool: dropping idle connection to " << key << " (" << reason << ")";
+                close(std::move(stream));
+            }
+        }
+
+    public:
+        SteamBot::Asio::Shard pickShard(const boost::urls::url& url)
+        {
+            std::string_view port=url.port();
+            if (port.empty()) port="443";
+            const auto key=makeKey(url.host(), port);
+            {
+                std::lock_guard<decltype(mutex)> lock(mutex);
+                auto iterator=idle.find(key);
+                if (iterator!=idle.end())
+                {
+                    return iterator->second.back().shard;
+                }
+            }
+            return SteamBot::Asio::pickShard();
+        }
+
+    public:
+        std::unique_ptr<Stream> acquire(SteamBot::Asio::Shard shard, std::string_view host, std::string_view port)
+        {
+            assert(SteamBot::Asio::isThread(shard));
+            const auto key=makeKey(host, port);
+
+            while (true)
+            {
+                Idle item;
+                {
+                    std::lock_guard<decltype(mutex)> lock(mutex);
+                    auto iterator=idle.find(key);
+                    if (iterator==idle.end())
+                    {
+                        return nullptr;
+                    }
+
+                    // most recently used first; it's the least likely to be stale
+                    auto& list=iterator->second;
+                    auto candidate=std::find_if(list.rbegin(), list.rend(), [shard](const Idle& entry) { return entry.shard==shard; });
+                    if (candidate==list.rend())
+                    {
+                        return nullptr;
+                    }
+                    item=std::move(*candidate);
+                    list.erase(std::next(candidate).base());
+                    if (list.empty())
+                    {
+                        idle.erase(iterator);
+                    }
+                    idleCount--;
+                }
+
+                // the handlers will run with an error, and not find the item
+                item.timer->cancel();
+                boost::beast::get_lowest_layer(*item.stream).socket().cancel();
+
+                if (isHealthy(*item.stream))
+                {
+                    reused++;
+                    BOOST_LOG_TRIVIAL(debug) << "ConnectionPool: reusing connection to " << key;
+                    return std::move(item.stream);
+                }
+
+                stale++;
+                BOOST_LOG_TRIVIAL(debug) << "ConnectionPool: idle connection to " << key << " has gone stale";
+                close(std::move(item.stream));
+            }
+        }
+
+    public:
+        void release(SteamBot::Asio::Shard shard, std::string_view host, std::string_view port, std::unique_ptr<Stream> stream)
+        {
+            assert(SteamBot::Asio::isThread(shard));
+            const auto key=makeKey(host, port);
+
+            boost::beast::get_lowest_layer(*stream).expires_never();
+            if (!isHealthy(*stream))
+            {
+                close(std::move(stream));
+                return;
+            }
+
+            auto& socket=boost::beast::get_lowest_layer(*stream).socket();
+            auto timer=std::make_shared<boost::asio::steady_timer>(SteamBot::Asio::getIoContext(shard), idleTimeout.load());
+
+            uint64_t id;
+            {
+                std::lock_guard<decltype(mutex)> lock(mutex);
+                auto& list=idle[key];
+                if (list.size()>=maxPerHost || idleCount>=maxTotal)
+                {
+                    if (list.empty())
+                    {
+                        idle.erase(key);
+                    }
+                    BOOST_LOG_TRIVIAL(debug) << "ConnectionPool: pool is full, closing connection to " << key;
+                    close(std::move(stream));
+                    return;
+                }
+                id=nextId++;
+                list.push_back(Idle{id, shard, std::move(stream), timer});
+                idleCount++;
+            }
+
+            timer->async_wait([this, key, id, timer](const boost::system::error_code& error) {
+                if (!error)
+                {
+                    drop(key, id, "idle timeout");
+                }
+            });
+
+            socket.async_wait(boost::asio::ip::tcp::socket::wait_read, [this, key, id](const boost::system::error_code& error) {
+                if (error!=boost::asio::error::operation_aborted)
+                {
+                    drop(key, id, "closed by server");
+                }
+            });
+        }
+
+    public:
+        size_t getIdleCount()
+        {
+            std::lock_guard<decltype(mutex)> lock(mutex);
+            return idleCount;
+        }
+    };
+}
+
+/************************************************************************/
+
+SteamBot::Asio::Shard SteamBot::HTTPClient::Internal::ConnectionPool::pickShard(const boost::urls::url& url)
+{
+    return Pool::get().pickShard(url);
+}
+
+/************************************************************************/
+
+std::unique_ptr<Stream> SteamBot::HTTPClient::Internal::ConnectionPool::acquire(SteamBot::Asio::Shard shard, std::string_view host, std::string_view port)
+{
+    return Pool::get().acquire(shard, host, port);
+}
+
+/************************************************************************/
+
+void SteamBot::HTTPClient::Internal::ConnectionPool::release(SteamBot::Asio::Shard shard, std::string_view host, std::string_view port, std::unique_ptr<Stream> stream)
+{
+    Pool::get().release(shard, host, port, std::move(stream));
+}
+
+/************************************************************************/
+
+void SteamBot::HTTPClient::Internal::ConnectionPool::created()
+{
+    Pool::get().created++;
+}
+
+/************************************************************************/
+
+void SteamBot::HTTPClient::Internal::ConnectionPool::stale()
+{
+    Pool::get().stale++;
+}
+
+/************************************************************************/
+
+void ConnectionPool::setMaxPerHost(size_t count)
+{
+    Pool::get().maxPerHost=count;
+}
+
+/************************************************************************/
+
+void ConnectionPool::setMaxTotal(size_t count)
+{
+    Pool::get().maxTotal=count;
+}
+
+/************************************************************************/
+
+void ConnectionPool::setIdleTimeout(std::chrono::steady_clock::duration timeout)
+{
+    Pool::get().idleTimeout=timeout;
+}
+
+/************************************************************************/
+
+ConnectionPool::Statistics ConnectionPool::getStatistics()
+{
+    auto& pool=Pool::get();
+
+    Statistics statistics;
+    statistics.created=pool.created;
+    statistics.reused=pool.reused;
+    statistics.stale=pool.stale;
+    statistics.idle=pool.getIdleCount();
+    return statistics;
+}
+
+/************************************************************************/
+
+void ConnectionPool::logStatistics()
+{
+    const auto statistics=getStatistics();
+    BOOST_LOG_TRIVIAL(info) << "HTTP connection pool: "
+                            << statistics.created << " connections made, "
+                            << statistics.reused << " reused, "
+                            << statistics.stale << " stale, "
+                            << statistics.idle << " idle";
+}
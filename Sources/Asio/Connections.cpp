@@ -24,10 +24,11 @@
 #include "Random.hpp"
 #include "Client/Client.hpp"
 #include "Helpers/JSON.hpp"
+#include "FiberStack.hpp"
+#include "LatencyHistogram.hpp"
 
 #include <boost/fiber/operations.hpp>
 #include <boost/exception/diagnostic_information.hpp>
-#include <boost/fiber/protected_fixedsize_stack.hpp>
 
 /************************************************************************/
 
@@ -49,22 +50,23 @@ Connections::Connections() =default;
 /************************************************************************/
 
 Connection::Connection(std::shared_ptr<SteamBot::WaiterBase>&& waiter_)
-    : ItemBase(std::move(waiter_))
+    : ItemBase(std::move(waiter_)),
+      shard(SteamBot::Asio::pickShard())
 {
-    auto baseConnection=std::make_unique<SteamBot::Connection::TCP>();
+    auto baseConnection=std::make_unique<SteamBot::Connection::TCP>(SteamBot::Asio::getIoContext(shard));
     connection=std::make_shared<SteamBot::Connection::Encrypted>(std::move(baseConnection));
 
-    BOOST_LOG_TRIVIAL(debug) << "created Steam connection " << this;
+    BOOST_LOG_TRIVIAL(debug) << "created Steam connection " << this << " on Asio shard " << shard;
 }
 
 /************************************************************************/
 
 Connection::~Connection()
 {
-    assert(!writingPackets);
+    assert(!writeScheduled);
     auto& myConnection=connection;
 
-    SteamBot::Asio::post("Connections::disconnect", [connection=std::move(myConnection)]() {
+    SteamBot::Asio::post(shard, "Connections::disconnect", [connection=std::move(myConnection)]() {
         connection->cancel();
     });
 
@@ -123,9 +125,9 @@ Connection::Status Connection::getStatus()
 
 /************************************************************************/
 
-std::vector<std::byte> Connection::readPacket()
+SteamBot::Connection::PacketBuffer Connection::readPacket()
 {
-    std::vector<std::byte> result;
+    SteamBot::Connection::PacketBuffer result;
     {
         std::lock_guard<decltype(mutex)> lock(mutex);
         if (!readPackets.empty())
@@ -202,9 +204,8 @@ bool Connections::readPacket(ConnectResult::weak_type result)
             if (locked)
             {
                 {
-                    std::vector<std::byte> bytes(packet.begin(), packet.end());
                     std::lock_guard<decltype(locked->mutex)> lock(locked->mutex);
-                    locked->readPackets.emplace(std::move(bytes));
+                    locked->readPackets.emplace(std::move(packet));
                 }
                 locked->wakeup();
                 return true;
@@ -240,7 +241,7 @@ bool Connections::readPacket(ConnectResult::weak_type result)
 
 void Connections::run(ConnectResult::weak_type result)
 {
-    assert(SteamBot::Asio::isThread());
+    assert([&result](){ auto locked=result.lock(); return !locked || SteamBot::Asio::isThread(locked->shard); }());
 
     try
     {
@@ -257,26 +258,49 @@ void Connections::run(ConnectResult::weak_type result)
 
 /************************************************************************/
 
+/*
+ * Drains the write queue, sending up to maxWriteBatch packets with
+ * each write.
+ */
+
 void Connection::doWritePackets()
 {
-    assert(SteamBot::Asio::isThread());
+    assert(SteamBot::Asio::isThread(shard));
+
+    auto& connections=Connections::get();
 
-    while (peekStatus()==Status::Connected)
+    std::vector<std::vector<std::byte>> batch;
+    std::vector<SteamBot::Connection::Base::ConstBytes> buffers;
+
+    while (true)
     {
-        std::vector<std::byte> packet;
         {
             std::lock_guard<decltype(mutex)> lock(mutex);
-            if (writePackets.empty())
+            if (status!=Status::Connected || writePackets.empty())
             {
+                writeScheduled=false;
                 return;
             }
-            packet=std::move(writePackets.front());
-            writePackets.pop();
+
+            const size_t maxBatch=connections.maxWriteBatch;
+            while (!writePackets.empty() && batch.size()<maxBatch)
+            {
+                batch.push_back(std::move(writePackets.front()));
+                writePackets.pop();
+            }
         }
 
         try
         {
-            connection->writePacket(packet);
+            buffers.assign(batch.begin(), batch.end());
+            connection->writePackets(buffers);
+
+            const uint64_t size=batch.size();
+            connections.writeBatches++;
+            connections.writtenPackets+=size;
+            uint64_t largest=connections.largestWriteBatch;
+            while (largest<size && !connections.largestWriteBatch.compare_exchange_weak(largest, size))
+                ;
         }
         catch(const boost::system::system_error& exception)
         {
@@ -302,6 +326,8 @@ void Connection::doWritePackets()
             BOOST_LOG_TRIVIAL(error) << "exception on Steam connection: " << boost::current_exception_diagnostic_information();
             setStatus(Connection::Status::Error);
         }
+
+        batch.clear();
     }
 }
 
@@ -356,57 +382,73 @@ void Connection::storeEndpoint() const
 /************************************************************************/
 /*
  * Tries to make a connection to the endpoint. We must be on a fiber
- * on the Asio thread for this to work.
+ * on the Asio thread of the connection's shard for this to work.
  */
 
 bool Connections::makeConnection(const Endpoint& endpoint, Connections::ConnectResult& result)
 {
     BOOST_LOG_TRIVIAL(info) << "connecting to " << endpoint.address << ":" << endpoint.port;
 
-    try
-    {
+    SteamBot::LatencyHistogram histogram("Connections::makeConnection");
+    return histogram.measure([&]() {
+        try
         {
-            std::lock_guard<decltype(result->mutex)> lock(result->mutex);
-            result->connection->connect(endpoint);
-            result->connection->getLocalAddress(result->localEndpoint);
-            result->remoteEndpoint=endpoint;
+            {
+                std::lock_guard<decltype(result->mutex)> lock(result->mutex);
+                result->connection->connect(endpoint);
+                result->connection->getLocalAddress(result->localEndpoint);
+                result->remoteEndpoint=endpoint;
+            }
+            result->setStatus(Connection::Status::Connected);
+            BOOST_LOG_TRIVIAL(info) << "connected to " << endpoint.address << ":" << endpoint.port;
+            return true;
         }
-        result->setStatus(Connection::Status::Connected);
-        BOOST_LOG_TRIVIAL(info) << "connected to " << endpoint.address << ":" << endpoint.port;
-        return true;
-    }
-    catch (const boost::system::system_error& exception)
-    {
-        if (exception.code().value()==boost::asio::error::eof)
+        catch (const boost::system::system_error& exception)
         {
-            // Not sure what's going on here, but it suddenly seems to happen a *lot*
-            BOOST_LOG_TRIVIAL(debug) << "remote end closed the connection?";
-            result->connection->disconnect();
-            return false;
+            if (exception.code().value()==boost::asio::error::eof)
+            {
+                // Not sure what's going on here, but it suddenly seems to happen a *lot*
+                BOOST_LOG_TRIVIAL(debug) << "remote end closed the connection?";
+                result->connection->disconnect();
+                return false;
+            }
+            throw;
         }
-        throw;
-    }
+    });
 }
 
 /************************************************************************/
 
-void Connections::fetchEndpointsAndMakeConnection(Connections::ConnectResult result)
+/*
+ * The CM list is fetched on the main Asio thread, so we need to get
+ * back to our shard to make the connection.
+ *
+ * We keep trying random endpoints until the deadline expires; the
+ * connection is then put into Error status, so the client doesn't
+ * wait forever.
+ */
+
+void Connections::fetchEndpointsAndMakeConnection(Connections::ConnectResult result, SteamBot::Deadline deadline)
 {
-    SteamBot::WebAPI::ISteamDirectory::GetCMList::get(0, [result=std::move(result)](std::shared_ptr<const SteamBot::WebAPI::ISteamDirectory::GetCMList> cmList) mutable {
-        boost::fibers::fiber(std::allocator_arg, boost::fibers::protected_fixedsize_stack(), [result=std::move(result), cmList=std::move(cmList)]() mutable {
-            int count=100;
-            while (--count>0)
-            {
-                const size_t index=SteamBot::Random::generateRandomNumber()%cmList->serverlist.size();
-                Endpoint endpoint(cmList->serverlist[index]);
-                if (makeConnection(endpoint, result))
+    SteamBot::WebAPI::ISteamDirectory::GetCMList::get(0, [result=std::move(result), deadline](std::shared_ptr<const SteamBot::WebAPI::ISteamDirectory::GetCMList> cmList) mutable {
+        const auto shard=result->shard;
+        SteamBot::Asio::post(shard, "Connections::fetchEndpointsAndMakeConnection", [result=std::move(result), cmList=std::move(cmList), deadline]() mutable {
+            boost::fibers::fiber(std::allocator_arg, SteamBot::FiberStack("Connections::connect"), [result=std::move(result), cmList=std::move(cmList), deadline]() mutable {
+                while (!deadline.expired())
                 {
-                    run(result);
-                    break;
+                    const size_t index=SteamBot::Random::generateRandomNumber()%cmList->serverlist.size();
+                    Endpoint endpoint(cmList->serverlist[index]);
+                    if (makeConnection(endpoint, result))
+                    {
+                        run(result);
+                        return;
+                    }
+                    boost::this_fiber::sleep_for(std::min<std::chrono::steady_clock::duration>(std::chrono::milliseconds(200), deadline.remaining()));
                 }
-                boost::this_fiber::sleep_for(std::chrono::milliseconds(200));
-            }
-        }).detach();
+                BOOST_LOG_TRIVIAL(error) << "could not connect to any CM server before the deadline";
+                result->setStatus(Connection::Status::Error);
+            }).detach();
+        });
     });
 }
 
@@ -426,24 +468,28 @@ Connections::ConnectResult Connections::connect(std::shared_ptr<SteamBot::Waiter
     auto result=waiter->createWaiter<ConnectResult::element_type>();
     auto previousEndpoint=getPreviousEndpoint();
 
-    SteamBot::Asio::post("Connections::connect", [result, previousEndpoint=std::move(previousEndpoint)]() mutable {
+    // the connecting fibers don't belong to the client, so they
+    // get the deadline explicitly
+    const auto deadline=SteamBot::Deadline::current().earliest(SteamBot::Deadline(get().connectTimeout.load()));
+
+    SteamBot::Asio::post(result->shard, "Connections::connect", [result, previousEndpoint=std::move(previousEndpoint), deadline]() mutable {
         if (previousEndpoint)
         {
             // We are still using the old fiber-based connection code
-            boost::fibers::fiber(std::allocator_arg, boost::fibers::protected_fixedsize_stack(), [result=std::move(result), previousEndpoint=std::move(previousEndpoint)]() mutable {
+            boost::fibers::fiber(std::allocator_arg, SteamBot::FiberStack("Connections::connect"), [result=std::move(result), previousEndpoint=std::move(previousEndpoint), deadline]() mutable {
                 if (makeConnection(*previousEndpoint, result))
                 {
                     run(result);
                 }
                 else
                 {
-                    fetchEndpointsAndMakeConnection(std::move(result));
+                    fetchEndpointsAndMakeConnection(std::move(result), deadline);
                 }
             }).detach();
         }
         else
         {
-            fetchEndpointsAndMakeConnection(std::move(result));
+            fetchEndpointsAndMakeConnection(std::move(result), deadline);
         }
     });
 
@@ -462,29 +508,52 @@ Connections::ConnectResult Connections::connect(std::shared_ptr<SteamBot::Waiter
 
 void Connection::writePacket(std::vector<std::byte> packet)
 {
+    bool schedule;
     {
         std::lock_guard<decltype(mutex)> lock(mutex);
         writePackets.emplace(std::move(packet));
+        schedule=!writeScheduled;
+        writeScheduled=true;
     }
 
-    auto locked=self.lock();
+    // Packets that are queued while we are already writing will be
+    // picked up by the running writer, as part of its next batch.
+    if (schedule)
+    {
+        auto locked=self.lock();
 
-    SteamBot::Asio::post("Connections::writePacket", [locked=std::move(locked)]() mutable {
-        if (!locked->writingPackets)
-        {
-            bool empty;
-            {
-                std::lock_guard<decltype(locked->mutex)> lock(locked->mutex);
-                empty=locked->writePackets.empty();
-            }
-            if (!empty)
-            {
-                locked->writingPackets=true;
-                boost::fibers::fiber([locked=std::move(locked)]() {
-                    locked->doWritePackets();
-                    locked->writingPackets=false;
-                }).detach();
-            }
-        }
-    });
+        SteamBot::Asio::post(shard, "Connections::writePacket", [locked=std::move(locked)]() mutable {
+            boost::fibers::fiber(std::allocator_arg, SteamBot::FiberStack("Connections::writePacket"), [locked=std::move(locked)]() {
+                locked->doWritePackets();
+            }).detach();
+        });
+    }
+}
+
+/************************************************************************/
+
+void Connections::setMaxWriteBatch(size_t size)
+{
+    assert(size>0);
+    get().maxWriteBatch=size;
+}
+
+/************************************************************************/
+
+void Connections::setConnectTimeout(std::chrono::steady_clock::duration timeout)
+{
+    get().connectTimeout=timeout;
+}
+
+/************************************************************************/
+
+Connections::WriteStatistics Connections::getWriteStatistics()
+{
+    auto& connections=get();
+
+    WriteStatistics statistics;
+    statistics.batches=connections.writeBatches;
+    statistics.packets=connections.writtenPackets;
+    statistics.largestBatch=connections.largestWriteBatch;
+    return statistics;
 }
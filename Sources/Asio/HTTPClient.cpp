@@ -19,9 +19,11 @@
 
 #include "Asio/RateLimit.hpp"
 #include "Client/Client.hpp"
+#include "LatencyHistogram.hpp"
 
 #include <boost/log/trivial.hpp>
 #include <boost/json/stream_parser.hpp>
+#include <boost/beast/core/error.hpp>
 #include <boost/exception/diagnostic_information.hpp>
 
 /************************************************************************/
@@ -30,9 +32,20 @@ namespace HTTPClient=SteamBot::HTTPClient;
 
 /************************************************************************/
 
+/*
+ * One query every 5 seconds per host and endpoint class, with bursts
+ * of up to 3, and up to 4 queries running at the same time.
+ *
+ * The old queue ran one query at a time with a 5 second gap, for
+ * everything. The sustained rate for each endpoint is still that
+ * 5 seconds. Bursts only happen after an endpoint has been idle, and
+ * a 429 or 503 response now makes us back off, instead of relying
+ * on a gap that was picked to never trigger one.
+ */
+
 HTTPClient::RateLimitQueue& HTTPClient::getDefaultQueue()
 {
-    static RateLimitQueue& queue=*new RateLimitQueue(std::chrono::seconds(5));
+    static RateLimitQueue& queue=*new RateLimitQueue(std::chrono::seconds(5), 3, 4);
     return queue;
 }
 
@@ -53,6 +66,11 @@ boost::json::value SteamBot::HTTPClient::parseJson(const SteamBot::HTTPClient::Q
 {
     assert(query.response.result()==boost::beast::http::status::ok);
 
+    if (query.streamJson)
+    {
+        return query.json;
+    }
+
     boost::json::stream_parser parser;
     const auto buffers=query.response.body().cdata();
     for (auto iterator=boost::asio::buffer_sequence_begin(buffers); iterator!=boost::asio::buffer_sequence_end(buffers); ++iterator)
@@ -67,6 +85,18 @@ boost::json::value SteamBot::HTTPClient::parseJson(const SteamBot::HTTPClient::Q
 
 /************************************************************************/
 
+boost::json::value SteamBot::HTTPClient::parseJson(SteamBot::HTTPClient::Query& query)
+{
+    if (query.streamJson)
+    {
+        assert(query.response.result()==boost::beast::http::status::ok);
+        return std::move(query.json);
+    }
+    return parseJson(static_cast<const SteamBot::HTTPClient::Query&>(query));
+}
+
+/************************************************************************/
+
 std::string SteamBot::HTTPClient::parseString(const SteamBot::HTTPClient::Query& query)
 {
     assert(query.response.result()==boost::beast::http::status::ok);
@@ -88,14 +118,24 @@ HTTPClient::Query::QueryPtr HTTPClient::perform(HTTPClient::Query::QueryPtr quer
     auto waiter=SteamBot::Waiter::create();
     auto cancellation=SteamBot::Client::getClient().cancel.registerObject(*waiter);
 
-    auto responseWaiter=queue.perform(waiter, std::move(query));
+    query->deadline=query->deadline.earliest(SteamBot::Deadline::current());
+    const auto deadline=query->deadline;
 
-    while (true)
-    {
-        waiter->wait();
-        if (auto response=responseWaiter->getResult())
+    SteamBot::LatencyHistogram histogram(std::string("HTTP ")+std::string(query->url.host()));
+    return histogram.measure([&]() {
+        auto responseWaiter=queue.perform(waiter, std::move(query));
+
+        while (true)
         {
-            return std::move(*response);
+            waiter->wait(deadline);
+            if (auto response=responseWaiter->getResult())
+            {
+                if ((*response)->error==boost::beast::error::timeout)
+                {
+                    throw SteamBot::TimeoutException();
+                }
+                return std::move(*response);
+            }
         }
-    }
+    });
 }
@@ -17,38 +17,243 @@
  * <http://www.gnu.org/licenses/>.
  */
 
+
 #include "Asio/RateLimit.hpp"
 #include "./BasicQuery.hpp"
 
 #include "Asio/Asio.hpp"
+#include "Client/Client.hpp"
+#include "Client/ClientInfo.hpp"
+#include "LatencyHistogram.hpp"
+
+#include <boost/beast/core/error.hpp>
+
+#include <algorithm>
+#include <charconv>
+#include <vector>
 
 /************************************************************************/
 
 typedef SteamBot::HTTPClient::RateLimitQueue RateLimitQueue;
 
 /************************************************************************/
+/*
+ * Backoff for servers that tell us to slow down, without telling us
+ * for how long
+ */
+
+static constexpr std::chrono::steady_clock::duration maxBackoff=std::chrono::minutes(15);
+
+/************************************************************************/
+/*
+ * How long a query waits before it moves up one priority
+ */
 
-RateLimitQueue::RateLimitQueue(std::chrono::steady_clock::duration schedule_)
-    : schedule(schedule_), timer(SteamBot::Asio::getIoContext(), decltype(schedule){})
+static std::chrono::steady_clock::duration promotion=std::chrono::seconds(30);
+
+/************************************************************************/
+
+void RateLimitQueue::setPromotion(Clock::duration duration)
 {
+    assert(duration>duration.zero());
+    promotion=duration;
 }
 
 /************************************************************************/
 
-void RateLimitQueue::runQuery(RateLimitQueue::WaiterType query)
+/*
+ * Weights of the accounts, for all queues
+ */
+
+static std::unordered_map<const SteamBot::ClientInfo*, unsigned int>& getWeights()
 {
-    assert(!inProgress);
-    inProgress=std::move(query);
+    static auto& weights=*new std::unordered_map<const SteamBot::ClientInfo*, unsigned int>;
+    return weights;
+}
+
+/************************************************************************/
+
+void RateLimitQueue::setWeight(const SteamBot::ClientInfo& clientInfo, unsigned int weight)
+{
+    assert(weight>0);
+    getWeights()[&clientInfo]=weight;
+}
+
+/************************************************************************/
+
+static const char* toString(SteamBot::HTTPClient::Query::Priority priority)
+{
+    switch(priority)
+    {
+    case SteamBot::HTTPClient::Query::Priority::TimeSensitive: return "time-sensitive";
+    case SteamBot::HTTPClient::Query::Priority::Interactive: return "interactive";
+    case SteamBot::HTTPClient::Query::Priority::Bulk: return "bulk";
+    }
+    assert(false);
+    return nullptr;
+}
+
+/************************************************************************/
+
+SteamBot::HTTPClient::Query::Priority RateLimitQueue::Queued::effectivePriority(Clock::time_point now) const
+{
+    auto level=static_cast<int>(priority);
+    level-=static_cast<int>((now-enqueued)/promotion);
+    return static_cast<Query::Priority>(std::max(level, 0));
+}
+
+/************************************************************************/
+
+RateLimitQueue::RateLimitQueue(Clock::duration schedule_, unsigned int burst_, unsigned int concurrency_)
+    : schedule(schedule_), burst(burst_), concurrency(concurrency_),
+      timer(SteamBot::Asio::getIoContext())
+{
+    assert(burst>0 && concurrency>0);
+}
+
+/************************************************************************/
+/*
+ * Buckets are per host and endpoint class, named "<host>/<class>".
+ * The class is Query::endpointClass, or the first segment of the
+ * path if that's empty.
+ */
+
+static std::string getBucketName(const SteamBot::HTTPClient::Query& query)
+{
+    std::string name=query.url.host();
+    name+='/';
+    if (!query.endpointClass.empty())
+    {
+        name+=query.endpointClass;
+    }
+    else
+    {
+        const auto segments=query.url.segments();
+        if (!segments.empty())
+        {
+            name+=segments.front();
+        }
+    }
+    return name;
+}
+
+/************************************************************************/
+/*
+ * Returns the bucket, with the tokens that have come back since we
+ * last looked.
+ */
+
+RateLimitQueue::Bucket& RateLimitQueue::getBucket(const std::string& name, Clock::time_point now)
+{
+    auto iterator=buckets.find(name);
+    if (iterator==buckets.end())
+    {
+        iterator=buckets.emplace(name, Bucket{static_cast<double>(burst), now, Clock::time_point::min()}).first;
+    }
+
+    auto& bucket=iterator->second;
+    if (now>bucket.updated)
+    {
+        bucket.tokens+=std::chrono::duration<double>(now-bucket.updated)/std::chrono::duration<double>(schedule);
+        if (bucket.tokens>burst) bucket.tokens=burst;
+        bucket.updated=now;
+    }
+    return bucket;
+}
+
+/************************************************************************/
+/*
+ * Queries without an account (not made from a client) are treated as
+ * another account.
+ */
+
+RateLimitQueue::Account& RateLimitQueue::getAccount(const SteamBot::ClientInfo* clientInfo)
+{
+    auto [iterator, inserted]=accounts.try_emplace(clientInfo);
+    if (inserted && clientInfo!=nullptr)
+    {
+        const auto& weights=getWeights();
+        auto weight=weights.find(clientInfo);
+        if (weight!=weights.end())
+        {
+            iterator->second.weight=weight->second;
+        }
+    }
+    return iterator->second;
+}
+
+/************************************************************************/
+/*
+ * A 429 or 503 response blocks the bucket for a while; anything else
+ * resets the backoff.
+ */
+
+void RateLimitQueue::queryCompleted(const WaiterType& query, const std::string& bucketName)
+{
+    const auto& result=*(query->setResult());
+    if (!result.error)
+    {
+        const auto now=Clock::now();
+        auto& bucket=getBucket(bucketName, now);
+
+        const auto status=result.response.result();
+        if (status==boost::beast::http::status::too_many_requests || status==boost::beast::http::status::service_unavailable)
+        {
+            Clock::duration backoff{0};
+            {
+                // we only support the "delay-seconds" form
+                const auto retryAfter=result.response[boost::beast::http::field::retry_after];
+                unsigned int seconds=0;
+                const auto last=retryAfter.data()+retryAfter.size();
+                const auto parsed=std::from_chars(retryAfter.data(), last, seconds);
+                if (!retryAfter.empty() && parsed.ec==std::errc() && parsed.ptr==last)
+                {
+                    backoff=std::chrono::seconds(seconds);
+                }
+            }
+            if (backoff==backoff.zero())
+            {
+                backoff=std::min(bucket.backoff==bucket.backoff.zero() ? 2*schedule : 2*bucket.backoff, maxBackoff);
+            }
+
+            BOOST_LOG_TRIVIAL(info) << "RateLimitQueue: " << bucketName << " responded with " << status << "; backing off for "
+                                    << std::chrono::duration_cast<std::chrono::seconds>(backoff).count() << " seconds";
+
+            bucket.backoff=backoff;
+            bucket.blockedUntil=now+backoff;
+            bucket.tokens=0;
+        }
+        else
+        {
+            bucket.backoff=Clock::duration::zero();
+        }
+    }
+
+    query->completed();
+    inProgress.erase(query);
+    startQuery();
+}
+
+/************************************************************************/
+
+void RateLimitQueue::runQuery(Queued item)
+{
+    const auto waited=Clock::now()-item.enqueued;
+    SteamBot::LatencyHistogram("HTTP queue "+item.bucket).record(waited);
+    SteamBot::LatencyHistogram(std::string("HTTP queue (")+toString(item.priority)+')').record(waited);
+    if (item.clientInfo!=nullptr)
+    {
+        SteamBot::LatencyHistogram("HTTP queue account "+item.clientInfo->accountName).record(waited);
+    }
+
+    auto [iterator, inserted]=inProgress.insert(std::move(item.query));
+    assert(inserted);
+    const auto& query=*iterator;
 
     typedef SteamBot::HTTPClient::Internal::BasicQuery BasicQuery;
-    auto myQuery=std::make_shared<BasicQuery>(*(inProgress->setResult()), [this](BasicQuery& basicQuery) {
-        assert(basicQuery.query==inProgress->setResult().get());
-        inProgress->completed();
-        BOOST_LOG_TRIVIAL(debug) << "RateLimitQueue: setting timer to fire in "
-                                 << std::chrono::duration_cast<std::chrono::seconds>(schedule).count() << " seconds";
-        timer.expires_after(schedule);
-        inProgress.reset();
-        startQuery();
+    auto myQuery=std::make_shared<BasicQuery>(*(query->setResult()), [this, query, bucketName=std::move(item.bucket)](BasicQuery& basicQuery) {
+        assert(basicQuery.query==query->setResult().get());
+        queryCompleted(query, bucketName);
     });
 
     SteamBot::HTTPClient::Internal::performWithRedirect(std::move(myQuery));
@@ -56,53 +261,123 @@ void RateLimitQueue::runQuery(RateLimitQueue::WaiterType query)
 
 /************************************************************************/
 /*
- * Start the next query, if we're not currently working on one and
- * enough time has passed since the previous one.
+ * Queries whose deadline has passed while they were waiting are
+ * completed with a timeout error, so they don't use up a slot.
+ */
+
+void RateLimitQueue::dropExpired()
+{
+    std::erase_if(queue, [this](Queued& item) {
+        auto& query=*(item.query->setResult());
+        if (!query.deadline.expired())
+        {
+            return false;
+        }
+        BOOST_LOG_TRIVIAL(info) << "RateLimitQueue: dropping expired query \"" << query.url << "\"";
+        query.error=boost::beast::error::timeout;
+        item.query->completed();
+        getAccount(item.clientInfo).queued--;
+        return true;
+    });
+}
+
+/************************************************************************/
+/*
+ * Start all queries that have a token in their bucket, as long as we
+ * have room for them. We always pick the best priority; within a
+ * priority, the account with the lowest virtual time, and then the
+ * query that was queued first. The last free slot is kept for
+ * queries that aren't bulk.
+ *
+ * If queries are left waiting for a token, the timer is set for
+ * the earliest time one will be available.
  */
 
 void RateLimitQueue::startQuery()
 {
-    BOOST_LOG_TRIVIAL(debug) << "RateLimitQueue::startQuery() with " << queue.size() << " queued requests";
+    BOOST_LOG_TRIVIAL(debug) << "RateLimitQueue::startQuery() with " << queue.size() << " queued and " << inProgress.size() << " running requests";
     assert(SteamBot::Asio::isThread());
 
-    if (!inProgress)
+    dropExpired();
+
+    const auto now=Clock::now();
+    auto earliest=Clock::time_point::max();
+
+    while (inProgress.size()<concurrency)
     {
-        if (!queue.empty())
+        const bool lastSlot=(concurrency>1 && inProgress.size()+1==concurrency);
+
+        auto best=queue.end();
+        Query::Priority bestPriority=Query::Priority::Bulk;
+        double bestTime=0;
+
+        for (auto iterator=queue.begin(); iterator!=queue.end(); ++iterator)
         {
-            timer.cancel();
-            if (timer.expiry()<=decltype(timer)::clock_type::now())
+            const auto priority=iterator->effectivePriority(now);
+            if (priority==Query::Priority::Bulk && lastSlot) continue;
+            if (best!=queue.end() && priority>bestPriority) continue;
+
+            auto& bucket=getBucket(iterator->bucket, now);
+            if (bucket.blockedUntil>now)
+            {
+                earliest=std::min(earliest, bucket.blockedUntil);
+            }
+            else if (bucket.tokens<1)
             {
-                WaiterType query=std::move(queue.front());
-                queue.pop();
-                runQuery(std::move(query));
+                const auto missing=std::chrono::duration<double>(schedule)*(1-bucket.tokens);
+                earliest=std::min(earliest, now+std::chrono::ceil<Clock::duration>(missing));
             }
             else
             {
-                auto seconds=std::chrono::duration_cast<std::chrono::seconds>(timer.expiry()-decltype(timer)::clock_type::now());
-                BOOST_LOG_TRIVIAL(debug) << "RateLimitQueue: waiting for timer to expire in " << seconds.count() << " seconds";
-
-                timer.async_wait([this](const boost::system::error_code& error) {
-                    BOOST_LOG_TRIVIAL(debug) << "RateLimitQueue: timer fired with error " << error;
-                    if (error)
-                    {
-                        if (error!=boost::asio::error::operation_aborted)
-                        {
-                            throw boost::system::system_error(error);
-                        }
-                    }
-                    else
-                    {
-                        startQuery();
-                    }
-                });
+                const auto time=getAccount(iterator->clientInfo).virtualTime;
+                if (best==queue.end() || priority<bestPriority || time<bestTime)
+                {
+                    best=iterator;
+                    bestPriority=priority;
+                    bestTime=time;
+                }
             }
         }
+
+        if (best==queue.end()) break;
+
+        auto& account=getAccount(best->clientInfo);
+        virtualTime=account.virtualTime;
+        account.virtualTime+=1.0/account.weight;
+        account.queued--;
+
+        getBucket(best->bucket, now).tokens-=1;
+        Queued item=std::move(*best);
+        queue.erase(best);
+        runQuery(std::move(item));
+    }
+
+    if (earliest!=Clock::time_point::max() && inProgress.size()<concurrency)
+    {
+        auto seconds=std::chrono::duration_cast<std::chrono::seconds>(earliest-now);
+        BOOST_LOG_TRIVIAL(debug) << "RateLimitQueue: waiting for timer to expire in " << seconds.count() << " seconds";
+
+        timer.expires_at(earliest);
+        timer.async_wait([this](const boost::system::error_code& error) {
+            BOOST_LOG_TRIVIAL(debug) << "RateLimitQueue: timer fired with error " << error;
+            if (error)
+            {
+                if (error!=boost::asio::error::operation_aborted)
+                {
+                    throw boost::system::system_error(error);
+                }
+            }
+            else
+            {
+                startQuery();
+            }
+        });
     }
 }
 
 /************************************************************************/
 /*
- * Enqueue a query, and start it if nothing is currently running.
+ * Enqueue a query, and start it if we can.
  *
  * This will push things to the Asio thread, if not already called on
  * it.
@@ -118,7 +393,18 @@ void RateLimitQueue::enqueue(RateLimitQueue::WaiterType result)
     }
     else
     {
-        queue.push(std::move(result));
+        std::string bucket=getBucketName(*result->setResult());
+        const auto priority=result->setResult()->priority;
+        const auto clientInfo=result->setResult()->clientInfo;
+
+        auto& account=getAccount(clientInfo);
+        if (account.queued==0)
+        {
+            account.virtualTime=std::max(account.virtualTime, virtualTime);
+        }
+        account.queued++;
+
+        queue.push_back(Queued{std::move(result), std::move(bucket), clientInfo, priority, Clock::now()});
         startQuery();
     }
 }
@@ -133,6 +419,14 @@ RateLimitQueue::WaiterType RateLimitQueue::perform(std::shared_ptr<SteamBot::Wai
 {
     BOOST_LOG_TRIVIAL(info) << "RateLimitQueue::perform \"" << query->url << "\"";
 
+    if (query->clientInfo==nullptr)
+    {
+        if (auto client=SteamBot::Client::getClientPtr())
+        {
+            query->clientInfo=&client->getClientInfo();
+        }
+    }
+
     auto result=waiter->createWaiter<Query::WaiterType>();
     result->setResult()=std::move(query);
     enqueue(result);
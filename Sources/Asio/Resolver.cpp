@@ -0,0 +1,284 @@
+/*
+ * This file is part of "Christians-Steam-Framework"
+ * Copyright (C) 2023- Christian Stieber
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 3, or (at
+ * your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; see the file LICENSE.  If not see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#include "Asio/Resolver.hpp"
+#include "LatencyHistogram.hpp"
+
+#include <atomic>
+#include <map>
+#include <mutex>
+#include <vector>
+
+/************************************************************************/
+/*
+ * Lookups run on the main Asio thread; the actual getaddrinfo()
+ * happens on Asio's internal resolver thread, so the main thread
+ * only needs to update the cache and hand out the results.
+ *
+ * Callbacks are always posted to their shard, even for cache hits,
+ * so callers get the same behavior as with async_resolve().
+ */
+
+typedef SteamBot::Asio::Resolver Resolver;
+
+/************************************************************************/
+
+namespace
+{
+    class Cache
+    {
+    private:
+        class Waiting
+        {
+        public:
+            SteamBot::Asio::Shard shard;
+            Resolver::Callback callback;
+        };
+
+        class Entry
+        {
+        public:
+            std::string host;
+            std::string port;
+
+            boost::system::error_code error;
+            std::vector<boost::asio::ip::tcp::endpoint> endpoints;
+            std::chrono::steady_clock::time_point expires;
+            std::chrono::steady_clock::time_point refresh;
+            size_t rotation=0;
+
+            bool lookupRunning=false;
+            std::vector<Waiting> waiting;
+
+        public:
+            bool isValid(std::chrono::steady_clock::time_point now) const
+            {
+                return now<expires;
+            }
+        };
+
+    private:
+        std::mutex mutex;
+        std::map<std::string, Entry, std::less<>> entries;
+
+    public:
+        std::atomic<std::chrono::steady_clock::duration> ttl{std::chrono::minutes(5)};
+        std::atomic<std::chrono::steady_clock::duration> negativeTTL{std::chrono::seconds(10)};
+
+        std::atomic<uint64_t> hits{0};
+        std::atomic<uint64_t> misses{0};
+        std::atomic<uint64_t> lookups{0};
+        std::atomic<uint64_t> prefetches{0};
+        std::atomic<uint64_t> failures{0};
+
+    private:
+        Cache() =default;
+
+    public:
+        static Cache& get()
+        {
+            static Cache& cache=*new Cache;
+            return cache;
+        }
+
+    private:
+        // Call with the mutex locked
+        static Resolver::Results getResults(Entry& entry)
+        {
+            auto& endpoints=entry.endpoints;
+            const size_t first=(endpoints.empty() ? 0 : entry.rotation++%endpoints.size());
+
+            std::vector<boost::asio::ip::tcp::endpoint> rotated;
+            rotated.reserve(endpoints.size());
+            rotated.insert(rotated.end(), endpoints.begin()+first, endpoints.end());
+            rotated.insert(rotated.end(), endpoints.begin(), endpoints.begin()+first);
+            return Resolver::Results::create(rotated.begin(), rotated.end(), entry.host, entry.port);
+        }
+
+        static void deliver(SteamBot::Asio::Shard shard, Resolver::Callback callback, boost::system::error_code error, Resolver::Results results)
+        {
+            SteamBot::Asio::post(shard, "Resolver::deliver", [callback=std::move(callback), error, results=std::move(results)]() {
+                callback(error, std::move(results));
+            });
+        }
+
+    private:
+        // Call with the mutex locked
+        void startLookup(const std::string& key, Entry& entry)
+        {
+            assert(!entry.lookupRunning);
+            entry.lookupRunning=true;
+            lookups++;
+
+            SteamBot::Asio::post("Resolver::lookup", [this, key, host=entry.host, port=entry.port]() {
+                auto resolver=std::make_shared<boost::asio::ip::tcp::resolver>(SteamBot::Asio::getIoContext());
+                const auto start=std::chrono::steady_clock::now();
+                resolver->async_resolve(host, port, [this, key, resolver, start](const boost::system::error_code& error, Resolver::Results results) {
+                    SteamBot::LatencyHistogram("DNS lookup").record(std::chrono::steady_clock::now()-start);
+                    completed(key, error, std::move(results));
+                });
+            });
+        }
+
+        void completed(const std::string& key, const boost::system::error_code& error, Resolver::Results results)
+        {
+            std::vector<Waiting> waiting;
+            std::vector<Resolver::Results> waitingResults;
+            boost::system::error_code waitingError;
+            {
+                std::lock_guard<decltype(mutex)> lock(mutex);
+                auto& entry=entries.at(key);
+                entry.lookupRunning=false;
+
+                const auto now=std::chrono::steady_clock::now();
+                if (error)
+                {
+                    BOOST_LOG_TRIVIAL(info) << "Resolver: lookup of \"" << entry.host << "\" has failed with " << error.message();
+                    failures++;
+
+                    // a failed refresh doesn't replace a good answer
+                    if (!entry.isValid(now) || entry.error)
+                    {
+                        entry.error=error;
+                        entry.endpoints.clear();
+                        entry.expires=now+negativeTTL.load();
+                        entry.refresh=entry.expires;
+                    }
+                }
+                else
+                {
+                    const auto duration=ttl.load();
+                    entry.error=boost::system::error_code();
+                    entry.endpoints.clear();
+                    for (const auto& item : results)
+                    {
+                        entry.endpoints.push_back(item.endpoint());
+                    }
+                    entry.expires=now+duration;
+                    entry.refresh=entry.expires-duration/5;
+                }
+
+                waiting=std::move(entry.waiting);
+                entry.waiting.clear();
+                waitingError=entry.error;
+                for (size_t i=0; i<waiting.size(); i++)
+                {
+                    waitingResults.push_back(getResults(entry));
+                }
+            }
+
+            for (size_t i=0; i<waiting.size(); i++)
+            {
+                deliver(waiting[i].shard, std::move(waiting[i].callback), waitingError, std::move(waitingResults[i]));
+            }
+        }
+
+    public:
+        void resolve(SteamBot::Asio::Shard shard, std::string host, std::string port, Resolver::Callback callback)
+        {
+            std::string key(host);
+            key.push_back(':');
+            key.append(port);
+
+            boost::system::error_code error;
+            Resolver::Results results;
+            {
+                std::lock_guard<decltype(mutex)> lock(mutex);
+                auto& entry=entries[key];
+                if (entry.host.empty())
+                {
+                    entry.host=std::move(host);
+                    entry.port=std::move(port);
+                }
+
+                const auto now=std::chrono::steady_clock::now();
+                if (!entry.isValid(now))
+                {
+                    misses++;
+                    entry.waiting.push_back(Waiting{shard, std::move(callback)});
+                    if (!entry.lookupRunning)
+                    {
+                        startLookup(key, entry);
+                    }
+                    return;
+                }
+
+                hits++;
+                if (now>=entry.refresh && !entry.lookupRunning && !entry.error)
+                {
+                    BOOST_LOG_TRIVIAL(debug) << "Resolver: refreshing \"" << entry.host << "\" before it expires";
+                    prefetches++;
+                    startLookup(key, entry);
+                }
+                error=entry.error;
+                results=getResults(entry);
+            }
+            deliver(shard, std::move(callback), error, std::move(results));
+        }
+    };
+}
+
+/************************************************************************/
+
+void Resolver::resolve(SteamBot::Asio::Shard shard, std::string host, std::string port, Resolver::Callback callback)
+{
+    Cache::get().resolve(shard, std::move(host), std::move(port), std::move(callback));
+}
+
+/************************************************************************/
+
+void Resolver::setTTL(std::chrono::steady_clock::duration duration)
+{
+    Cache::get().ttl=duration;
+}
+
+/************************************************************************/
+
+void Resolver::setNegativeTTL(std::chrono::steady_clock::duration duration)
+{
+    Cache::get().negativeTTL=duration;
+}
+
+/************************************************************************/
+
+Resolver::Statistics Resolver::getStatistics()
+{
+    auto& cache=Cache::get();
+
+    Statistics statistics;
+    statistics.hits=cache.hits;
+    statistics.misses=cache.misses;
+    statistics.lookups=cache.lookups;
+    statistics.prefetches=cache.prefetches;
+    statistics.failures=cache.failures;
+    return statistics;
+}
+
+/************************************************************************/
+
+void Resolver::logStatistics()
+{
+    const auto statistics=getStatistics();
+    BOOST_LOG_TRIVIAL(info) << "DNS cache: "
+                            << statistics.hits << " hits, "
+                            << statistics.misses << " misses, "
+                            << statistics.lookups << " lookups ("
+                            << statistics.prefetches << " prefetches), "
+                            << statistics.failures << " failures";
+}
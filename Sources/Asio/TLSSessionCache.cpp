@@ -0,0 +1,197 @@
+/*
+ * This file is part of "Christians-Steam-Framework"
+ * Copyright (C) 2023- Christian Stieber
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 3, or (at
+ * your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; see the file LICENSE.  If not see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#include "./BasicQuery.hpp"
+
+#include <openssl/ssl.h>
+
+#include <atomic>
+#include <map>
+#include <mutex>
+
+/************************************************************************/
+/*
+ * OpenSSL doesn't look up client sessions by itself, so we keep
+ * our own cache: the context hands us every new session through the
+ * "new session" callback (for TLS 1.3, that's whenever the server
+ * sends a ticket), and we store it under the SNI host name.
+ *
+ * Handshakes happen on all shards, so this is protected by a mutex.
+ */
+
+typedef SteamBot::HTTPClient::TLSSessionCache TLSSessionCache;
+
+/************************************************************************/
+
+namespace
+{
+    class Cache
+    {
+    private:
+        class SessionDeleter
+        {
+        public:
+            void operator()(SSL_SESSION* session) const
+            {
+                SSL_SESSION_free(session);
+            }
+        };
+
+        typedef std::unique_ptr<SSL_SESSION, SessionDeleter> SessionPtr;
+
+    private:
+        std::mutex mutex;
+        std::map<std::string, SessionPtr, std::less<>> sessions;
+
+    public:
+        std::atomic<uint64_t> fullHandshakes{0};
+        std::atomic<uint64_t> resumedHandshakes{0};
+
+    private:
+        Cache() =default;
+
+    public:
+        static Cache& get()
+        {
+            static Cache& cache=*new Cache;
+            return cache;
+        }
+
+    private:
+        static int newSession(SSL* ssl, SSL_SESSION* session)
+        {
+            const char* host=SSL_get_servername(ssl, TLSEXT_NAMETYPE_host_name);
+            if (host==nullptr || !SSL_SESSION_is_resumable(session))
+            {
+                return 0;
+            }
+
+            auto& cache=get();
+            std::lock_guard<decltype(cache.mutex)> lock(cache.mutex);
+            cache.sessions[host]=SessionPtr(session);
+            return 1;		// we took the reference
+        }
+
+    public:
+        void install(boost::asio::ssl::context& context)
+        {
+            SSL_CTX_set_session_cache_mode(context.native_handle(), SSL_SESS_CACHE_CLIENT | SSL_SESS_CACHE_NO_INTERNAL_STORE);
+            SSL_CTX_sess_set_new_cb(context.native_handle(), &newSession);
+        }
+
+        /*
+         * TLS 1.3 tickets should only be used once; the server will
+         * send a new one on the resumed connection.
+         *
+         * OpenSSL marks a session as not resumable if a connection
+         * using it fails, so we need to check that again.
+         */
+        void apply(SSL* ssl, const std::string& host)
+        {
+            SessionPtr session;
+            {
+                std::lock_guard<decltype(mutex)> lock(mutex);
+                auto iterator=sessions.find(host);
+                if (iterator==sessions.end())
+                {
+                    return;
+                }
+                if (!SSL_SESSION_is_resumable(iterator->second.get()))
+                {
+                    sessions.erase(iterator);
+                    return;
+                }
+                if (SSL_SESSION_get_protocol_version(iterator->second.get())>=TLS1_3_VERSION)
+                {
+                    session=std::move(iterator->second);
+                    sessions.erase(iterator);
+                }
+                else
+                {
+                    SSL_SESSION_up_ref(iterator->second.get());
+                    session.reset(iterator->second.get());
+                }
+            }
+            SSL_set_session(ssl, session.get());
+        }
+
+        void handshakeCompleted(SSL* ssl)
+        {
+            if (SSL_session_reused(ssl))
+            {
+                resumedHandshakes++;
+            }
+            else
+            {
+                fullHandshakes++;
+            }
+        }
+
+        size_t getSessionCount()
+        {
+            std::lock_guard<decltype(mutex)> lock(mutex);
+            return sessions.size();
+        }
+    };
+}
+
+/************************************************************************/
+
+void SteamBot::HTTPClient::Internal::TLSSessionCache::install(boost::asio::ssl::context& context)
+{
+    Cache::get().install(context);
+}
+
+/************************************************************************/
+
+void SteamBot::HTTPClient::Internal::TLSSessionCache::apply(SSL* ssl, const std::string& host)
+{
+    Cache::get().apply(ssl, host);
+}
+
+/************************************************************************/
+
+void SteamBot::HTTPClient::Internal::TLSSessionCache::handshakeCompleted(SSL* ssl)
+{
+    Cache::get().handshakeCompleted(ssl);
+}
+
+/************************************************************************/
+
+TLSSessionCache::Statistics TLSSessionCache::getStatistics()
+{
+    auto& cache=Cache::get();
+
+    Statistics statistics;
+    statistics.fullHandshakes=cache.fullHandshakes;
+    statistics.resumedHandshakes=cache.resumedHandshakes;
+    statistics.sessions=cache.getSessionCount();
+    return statistics;
+}
+
+/************************************************************************/
+
+void TLSSessionCache::logStatistics()
+{
+    const auto statistics=getStatistics();
+    BOOST_LOG_TRIVIAL(info) << "TLS sessions: "
+                            << statistics.fullHandshakes << " full handshakes, "
+                            << statistics.resumedHandshakes << " resumed, "
+                            << statistics.sessions << " cached";
+}
@@ -269,30 +269,46 @@ void AssetData::storeReceivedData(std::shared_ptr<GetAssetClassInfoInfo::ResultT
 
 void AssetData::requestData(const MissingKeys& missing)
 {
+    std::vector<GetAssetClassInfoInfo::RequestType> requests;
+    requests.reserve(missing.size());
     for (const auto& chunk : missing)
     {
-        std::shared_ptr<GetAssetClassInfoInfo::ResultType> response;
+        auto& request=requests.emplace_back();
+        request.set_language("english");
+        assert(chunk.first!=SteamBot::AppID::None);
+        const auto appId=toInteger(chunk.first);
+        assert(appId>=0);
+        request.set_appid(static_cast<uint32_t>(appId));
+        for (const auto& key : chunk.second)
         {
-            GetAssetClassInfoInfo::RequestType request;
-            request.set_language("english");
-            assert(chunk.first!=SteamBot::AppID::None);
-            const auto appId=toInteger(chunk.first);
-            assert(appId>=0);
-            request.set_appid(static_cast<uint32_t>(appId));
-            for (const auto& key : chunk.second)
+            auto& item=*(request.add_classes());
+            assert(key->classId!=SteamBot::ClassID::None);
+            item.set_classid(toInteger(key->classId));
+            if (key->instanceId!=SteamBot::InstanceID::None)
             {
-                auto& item=*(request.add_classes());
-                assert(key->classId!=SteamBot::ClassID::None);
-                item.set_classid(toInteger(key->classId));
-                if (key->instanceId!=SteamBot::InstanceID::None)
-                {
-                    item.set_instanceid(toInteger(key->instanceId));
-                }
+                item.set_instanceid(toInteger(key->instanceId));
             }
-            response=SteamBot::Modules::UnifiedMessageClient::execute<GetAssetClassInfoInfo::ResultType>("Econ.GetAssetClassInfo#1", std::move(request));
-            storeReceivedData(std::move(response));
         }
     }
+
+    // Store every chunk we got, then report the first error
+    std::exception_ptr error;
+    auto responses=SteamBot::Modules::UnifiedMessageClient::executeMany<GetAssetClassInfoInfo::ResultType>("Econ.GetAssetClassInfo#1", std::move(requests));
+    for (auto& response : responses)
+    {
+        try
+        {
+            storeReceivedData(response.get());
+        }
+        catch(...)
+        {
+            if (!error) error=std::current_exception();
+        }
+    }
+    if (error)
+    {
+        std::rethrow_exception(error);
+    }
 }
 
 /************************************************************************/
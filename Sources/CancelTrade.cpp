@@ -57,6 +57,7 @@ namespace
         {
             makeBody(tradeOfferId);
             makeUrls(tradeOfferId);
+            priority=SteamBot::HTTPClient::Query::Priority::TimeSensitive;
         }
     };
 }
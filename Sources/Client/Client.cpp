@@ -28,20 +28,92 @@
 #include "TypeName.hpp"
 #include "Client/Fiber.hpp"
 #include "Client/Counter.hpp"
+#include "FiberStack.hpp"
+#include "LatencyHistogram.hpp"
+#include "Asio/HTTPClient.hpp"
+#include "Asio/Resolver.hpp"
 
+#include <atomic>
 #include <thread>
 #include <boost/log/trivial.hpp>
 #include <boost/exception/diagnostic_information.hpp>
 #include <boost/fiber/operations.hpp>
-#include <boost/fiber/protected_fixedsize_stack.hpp>
+#include <boost/fiber/buffered_channel.hpp>
 
 /************************************************************************/
 
-static thread_local std::shared_ptr<SteamBot::Client> currentClient;
+static SteamBot::Counter threadCounter;
 
 /************************************************************************/
+/*
+ * By default, each client gets its own thread. With a number of
+ * worker threads set, clients are distributed over these instead,
+ * and a worker thread runs the fibers of several clients.
+ *
+ * Clients are assigned round-robin, and stay on their worker. We
+ * don't steal work between threads, since the whiteboard,
+ * messageboard and modules of a client are not threadsafe.
+ */
 
-static SteamBot::Counter threadCounter;
+static unsigned int workerThreads=0;
+
+namespace
+{
+    class Workers
+    {
+    private:
+        class Worker
+        {
+        private:
+            boost::fibers::buffered_channel<std::function<void()>> channel{64};
+
+        public:
+            Worker()
+            {
+                std::thread([this](){
+                    boost::fibers::use_scheduling_algorithm<SteamBot::ClientFiber::Scheduler>();
+                    std::function<void()> function;
+                    while (channel.pop(function)==boost::fibers::channel_op_status::success)
+                    {
+                        boost::fibers::fiber(std::allocator_arg, SteamBot::FiberStack("Client::launch"), std::move(function)).detach();
+                    }
+                }).detach();
+            }
+
+            void launch(std::function<void()> function)
+            {
+                channel.push(std::move(function));
+            }
+        };
+
+    private:
+        std::vector<std::unique_ptr<Worker>> workers;
+        std::atomic<size_t> next{0};
+
+    private:
+        Workers()
+        {
+            assert(workerThreads>0);
+            BOOST_LOG_TRIVIAL(info) << "using " << workerThreads << " client worker threads";
+            for (unsigned int i=0; i<workerThreads; i++)
+            {
+                workers.push_back(std::make_unique<Worker>());
+            }
+        }
+
+    public:
+        static Workers& get()
+        {
+            static Workers& workers=*new Workers;
+            return workers;
+        }
+
+        void launch(std::function<void()> function)
+        {
+            workers[next++%workers.size()]->launch(std::move(function));
+        }
+    };
+}
 
 /************************************************************************/
 
@@ -87,7 +159,7 @@ void SteamBot::Client::quit(bool restart)
 
 void SteamBot::Client::waitReady() const
 {
-    if (currentClient.get()!=this)
+    if (getClientPtr()!=this)
     {
         std::unique_lock<decltype(statusMutex)> lock(statusMutex);
         statusCondition.wait(lock, [this]() { return status!=Status::Initializing; });
@@ -157,52 +229,76 @@ void SteamBot::Client::launch(SteamBot::ClientInfo& clientInfo)
     {
         struct Launcher
         {
-            static void launch(SteamBot::ClientInfo& clientInfo)
+            // This runs as a fiber on a thread with a ClientFiber::Scheduler
+            static void run(SteamBot::ClientInfo& clientInfo)
             {
-                BOOST_LOG_TRIVIAL(debug) << "Client::launch()";
-                assert(clientInfo.isActive());
+                auto properties=ClientFiber::Properties::get();
+                assert(properties!=nullptr);
 
-                std::thread([counter = threadCounter(), &clientInfo]() mutable {
-                    ClientFiber::Scheduler* scheduler=nullptr;
-                    boost::fibers::use_scheduling_algorithm<ClientFiber::Scheduler>(scheduler);
-                    scheduler->setBaseCounter();
+                auto currentClient=std::make_shared<Client>(clientInfo);
+                auto tracker=std::make_shared<ClientFiber::Tracker>();
+                properties->setClient(currentClient, tracker);
+                tracker->setBaseCounter();
 
-                    currentClient=std::make_shared<Client>(clientInfo);
+                clientInfo.setClient(currentClient);
+                {
+                    SteamBot::UI::Thread::outputText(std::string("running client ")+clientInfo.displayName());
+                    currentClient->initModules();
 
-                    clientInfo.setClient(currentClient);
                     {
-                        SteamBot::UI::Thread::outputText(std::string("running client ")+clientInfo.displayName());
-                        currentClient->initModules();
-
-                        {
-                            std::lock_guard<decltype(currentClient->statusMutex)> lock(currentClient->statusMutex);
-                            currentClient->status=Status::Ready;
-                        }
-                        currentClient->statusCondition.notify_all();
-
-                        scheduler->wait();
-                        SteamBot::UI::Thread::outputText(std::string("exiting client ")+clientInfo.displayName());
+                        std::lock_guard<decltype(currentClient->statusMutex)> lock(currentClient->statusMutex);
+                        currentClient->status=Status::Ready;
                     }
-                    clientInfo.setClient(nullptr);
+                    currentClient->statusCondition.notify_all();
+
+                    tracker->wait();
+                    SteamBot::UI::Thread::outputText(std::string("exiting client ")+clientInfo.displayName());
+                }
+                clientInfo.setClient(nullptr);
+
+                const auto quitMode=currentClient->quitMode;
+                BOOST_LOG_TRIVIAL(info) << "client quit with mode \"" << SteamBot::enumToStringAlways(quitMode) << "\"";
+
+                properties->setClient(nullptr, nullptr);
+                currentClient.reset();
+
+                switch(quitMode)
+                {
+                case QuitMode::None:
+                case QuitMode::Quit:
+                    clientInfo.setActive(false);
+                    break;
+
+                case QuitMode::Restart:
+                    boost::this_fiber::sleep_for(std::chrono::seconds(15));
+                    launch(clientInfo);
+                    break;
+
+                default:
+                    assert(false);
+                }
+            }
 
-                    BOOST_LOG_TRIVIAL(info) << "client quit with mode \"" << SteamBot::enumToStringAlways(currentClient->quitMode) << "\"";
-                    switch(currentClient->quitMode)
-                    {
-                    case QuitMode::None:
-                    case QuitMode::Quit:
-                        clientInfo.setActive(false);
-                        break;
-
-                    case QuitMode::Restart:
-                        currentClient.reset();
-                        std::this_thread::sleep_for(std::chrono::seconds(15));
-                        launch(clientInfo);
-                        break;
-
-                    default:
-                        assert(false);
-                    }
-                }).detach();
+            static void launch(SteamBot::ClientInfo& clientInfo)
+            {
+                BOOST_LOG_TRIVIAL(debug) << "Client::launch()";
+                assert(clientInfo.isActive());
+
+                std::function<void()> body=[counter = threadCounter(), &clientInfo]() {
+                    run(clientInfo);
+                };
+
+                if (workerThreads==0)
+                {
+                    std::thread([body=std::move(body)]() mutable {
+                        boost::fibers::use_scheduling_algorithm<ClientFiber::Scheduler>();
+                        boost::fibers::fiber(std::allocator_arg, SteamBot::FiberStack("Client::launch"), std::move(body)).join();
+                    }).detach();
+                }
+                else
+                {
+                    Workers::get().launch(std::move(body));
+                }
             }
         };
 
@@ -223,28 +319,59 @@ void SteamBot::Client::waitAll()
 {
     threadCounter.wait();
     BOOST_LOG_TRIVIAL(info) << "all clients have quit";
+    SteamBot::FiberStack::logStatistics();
+    SteamBot::LatencyHistogram::logStatistics();
+    SteamBot::HTTPClient::ConnectionPool::logStatistics();
+    SteamBot::HTTPClient::TLSSessionCache::logStatistics();
+    SteamBot::Asio::Resolver::logStatistics();
 }
 
 /************************************************************************/
 
+/*
+ * Must be called before the first client is launched. 0 means "one
+ * thread per client".
+ */
+
+void SteamBot::Client::setWorkerThreads(unsigned int count)
+{
+    workerThreads=count;
+}
+
+/************************************************************************/
+/*
+ * The current client is stored in the properties of the running
+ * fiber. Fibers that don't belong to a client, as well as other
+ * threads, don't have a client.
+ */
+
 std::shared_ptr<SteamBot::Client> SteamBot::Client::getClientShared()
 {
-    return currentClient;
+    if (auto properties=ClientFiber::Properties::get())
+    {
+        return properties->getClient();
+    }
+    return nullptr;
 }
 
 /************************************************************************/
 
 SteamBot::Client* SteamBot::Client::getClientPtr()
 {
-    return currentClient.get();
+    if (auto properties=ClientFiber::Properties::get())
+    {
+        return properties->getClient().get();
+    }
+    return nullptr;
 }
 
 /************************************************************************/
 
 SteamBot::Client& SteamBot::Client::getClient()
 {
-    assert(currentClient);
-    return *currentClient;
+    auto client=getClientPtr();
+    assert(client!=nullptr);
+    return *client;
 }
 
 /************************************************************************/
@@ -255,7 +382,8 @@ SteamBot::Client& SteamBot::Client::getClient()
 
 void SteamBot::Client::launchFiber(std::string name, std::function<void()> body)
 {
-	boost::fibers::fiber(std::allocator_arg, boost::fibers::protected_fixedsize_stack(),
+	SteamBot::FiberStack stack(name);
+	boost::fibers::fiber(std::allocator_arg, stack,
                          [this, name=std::move(name), body=std::move(body)](){
         std::string fiberName;
         {
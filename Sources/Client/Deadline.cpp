@@ -0,0 +1,83 @@
+/*
+ * This file is part of "Christians-Steam-Framework"
+ * Copyright (C) 2023- Christian Stieber
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 3, or (at
+ * your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; see the file LICENSE.  If not see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#include "Client/Deadline.hpp"
+#include "Client/Fiber.hpp"
+#include "Exceptions.hpp"
+
+/************************************************************************/
+
+typedef SteamBot::Deadline Deadline;
+
+/************************************************************************/
+
+Deadline::Clock::duration Deadline::remaining() const
+{
+    if (!isSet())
+    {
+        return Clock::duration::max();
+    }
+    const auto now=Clock::now();
+    return (now<when) ? when-now : Clock::duration::zero();
+}
+
+/************************************************************************/
+
+void Deadline::check() const
+{
+    if (expired())
+    {
+        throw SteamBot::TimeoutException();
+    }
+}
+
+/************************************************************************/
+/*
+ * Fibers that don't belong to a client don't have a deadline
+ */
+
+Deadline Deadline::current()
+{
+    if (auto properties=SteamBot::ClientFiber::Properties::get())
+    {
+        return properties->deadline;
+    }
+    return Deadline();
+}
+
+/************************************************************************/
+
+Deadline::Scope::Scope(Deadline deadline)
+{
+    if (auto properties=SteamBot::ClientFiber::Properties::get())
+    {
+        previous=properties->deadline;
+        properties->deadline=previous.earliest(deadline);
+    }
+}
+
+/************************************************************************/
+
+Deadline::Scope::~Scope()
+{
+    if (auto properties=SteamBot::ClientFiber::Properties::get())
+    {
+        properties->deadline=previous;
+    }
+}
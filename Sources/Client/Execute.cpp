@@ -66,8 +66,10 @@ void SteamBot::Execute::FunctionBase::complete()
 void SteamBot::Execute::enqueue(FunctionBase::Ptr function)
 
 {
-    std::lock_guard<decltype(mutex)> lock(mutex);
-    queue.emplace(function);
+    {
+        std::lock_guard<decltype(mutex)> lock(mutex);
+        queue.emplace(function);
+    }
     wakeup();
 }
 
@@ -20,6 +20,11 @@
 #include "Client/Messageboard.hpp"
 #include "Vector.hpp"
 
+#include <boost/log/trivial.hpp>
+
+#include <algorithm>
+#include <atomic>
+
 /************************************************************************/
 
 SteamBot::Messageboard::Messageboard() =default;
@@ -28,13 +33,26 @@ SteamBot::Messageboard::Messageboard() =default;
 
 SteamBot::Messageboard::~Messageboard()
 {
-    assert(waiters.empty());	// must not destruct while there are still waiters!!
+    // must not destruct while there are still waiters!!
+    assert(std::all_of(subscribers.begin(), subscribers.end(), [](const auto& item) { return !item || item->empty(); }));
 }
 
 /************************************************************************/
+/*
+ * Slots are shared by all messageboards, and clients can run on
+ * different threads.
+ */
 
-SteamBot::Messageboard::WaiterBase::WaiterBase(std::shared_ptr<SteamBot::WaiterBase> waiter_, SteamBot::Messageboard& messageboard_)
-    : ItemBase(std::move(waiter_)), messageboard(messageboard_)
+SteamBot::Messageboard::Slot SteamBot::Messageboard::nextSlot()
+{
+    static std::atomic<Slot> counter{0};
+    return counter++;
+}
+
+/************************************************************************/
+
+SteamBot::Messageboard::WaiterBase::WaiterBase(std::shared_ptr<SteamBot::WaiterBase> waiter_, SteamBot::Messageboard& messageboard_, QueuePolicy policy_)
+    : ItemBase(std::move(waiter_)), messageboard(messageboard_), policy(policy_)
 {
 }
 
@@ -43,34 +61,11 @@ SteamBot::Messageboard::WaiterBase::WaiterBase(std::shared_ptr<SteamBot::WaiterB
 SteamBot::Messageboard::WaiterBase::~WaiterBase() =default;
 
 /************************************************************************/
-/*
- * Performs "callback" on all waiters for type "key".
- *
- * This will also clean up released waiters.
- *
- * Pass a "nullptr" callback if you only want to perform the cleanup.
- */
 
-void SteamBot::Messageboard::action(const std::type_index& key, std::function<void(std::shared_ptr<WaiterBase>)> callback)
+void SteamBot::Messageboard::WaiterBase::logStatistics(const std::string& name) const
 {
-    const auto iterator=waiters.find(key);
-    if (iterator!=waiters.end())
-    {
-        SteamBot::erase(iterator->second, [&callback](std::weak_ptr<WaiterBase>& waiter){
-            auto locked=waiter.lock();
-            if (locked)
-            {
-                if (callback) callback(locked);
-                return false;
-            }
-            else
-            {
-                return true;
-            }
-        });
-        if (iterator->second.empty())
-        {
-            waiters.erase(iterator);
-        }
-    }
+    BOOST_LOG_TRIVIAL(info) << "messageboard queue for " << name << ": "
+                            << statistics.received << " messages, max depth " << statistics.maxDepth
+                            << ", dropped " << statistics.dropped << ", coalesced " << statistics.coalesced
+                            << ", blocked " << statistics.blocked << " times";
 }
@@ -0,0 +1,533 @@
+/*
+ * This file is part of "Christians-Steam-Framework"
+ * Copyright (C) 2023- Christian Stieber
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 3, or (at
+ * your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; see the file LICENSE.  If not see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#include "Client/Timer.hpp"
+#include "Client/Client.hpp"
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <limits>
+
+#include <boost/fiber/condition_variable.hpp>
+#include <boost/fiber/mutex.hpp>
+
+/************************************************************************/
+/*
+ * The wheel has "levels" levels of 64 slots each. A slot on level 0
+ * covers one tick, a slot on level 1 covers 64 ticks, and so on.
+ *
+ * A timer goes on the highest level where its expiry tick differs
+ * from the current tick; when the current tick reaches the start
+ * of that slot, the timers are "cascaded" down to the lower levels.
+ * Each level has a bitmap of non-empty slots, so finding the next
+ * tick we need to wake up for doesn't look at the empty slots.
+ *
+ * Timers that are too far in the future for the top level are kept
+ * in an overflow list, which gets reinserted whenever the top level
+ * wraps around.
+ */
+
+typedef SteamBot::Timer Timer;
+typedef Timer::Clock Clock;
+
+/************************************************************************/
+
+static constinit std::chrono::milliseconds resolution{100};
+
+/************************************************************************/
+
+class SteamBot::Timer::Wheel : public std::enable_shared_from_this<Wheel>
+{
+private:
+    static constexpr unsigned int bits=6;
+    static constexpr unsigned int slots=1<<bits;
+    static constexpr unsigned int levels=4;
+
+    static constexpr uint64_t never=std::numeric_limits<uint64_t>::max();
+
+private:
+    boost::fibers::mutex mutex;
+    boost::fibers::condition_variable condition;
+
+    std::array<std::array<std::vector<Timer*>, slots>, levels> wheel;
+    std::array<uint64_t, levels> occupied{};
+    std::vector<Timer*> overflow;
+
+    uint64_t current;
+    size_t count=0;
+
+    uint64_t sleepingUntil=never;
+    bool changed=false;
+    bool running=false;
+    bool cancelled=false;
+
+private:
+    std::vector<Timer*>& getSlot(const Timer&);
+    void place(Timer&);
+    void unlink(Timer&);
+    void cascade(std::vector<Timer*>&);
+    void process(std::vector<std::shared_ptr<Timer>>&);
+    uint64_t nextTick() const;
+    void run();
+
+public:
+    static uint64_t toTick(Clock::time_point, bool roundUp);
+    static Clock::time_point fromTick(uint64_t);
+
+public:
+    Wheel();
+    ~Wheel();
+
+    void add(Timer&);
+    void remove(Timer&);
+    void cancel();
+};
+
+/************************************************************************/
+
+Timer::Wheel::Wheel()
+    : current(toTick(Clock::now(), false))
+{
+}
+
+Timer::Wheel::~Wheel()
+{
+    assert(count==0 || cancelled);
+}
+
+/************************************************************************/
+
+uint64_t Timer::Wheel::toTick(Clock::time_point when, bool roundUp)
+{
+    const auto duration=when.time_since_epoch();
+    uint64_t tick=duration/resolution;
+    if (roundUp && tick*resolution<duration)
+    {
+        tick++;
+    }
+    return tick;
+}
+
+/************************************************************************/
+
+Clock::time_point Timer::Wheel::fromTick(uint64_t tick)
+{
+    return Clock::time_point(std::chrono::duration_cast<Clock::duration>(tick*resolution));
+}
+
+/************************************************************************/
+
+std::vector<Timer*>& Timer::Wheel::getSlot(const Timer& timer)
+{
+    if (timer.level>=levels)
+    {
+        return overflow;
+    }
+    return wheel[timer.level][timer.slot];
+}
+
+/************************************************************************/
+/*
+ * Puts an armed timer into its slot, according to the current tick.
+ * A timer that expires on the current tick goes into the current
+ * level 0 slot, so process() can only do this while cascading.
+ */
+
+void Timer::Wheel::place(Timer& timer)
+{
+    const uint64_t difference=timer.expires^current;
+    if (timer.expires<=current || difference==0)
+    {
+        timer.level=0;
+        timer.slot=current%slots;
+    }
+    else
+    {
+        // anything above the top level goes into the overflow list
+        timer.level=static_cast<uint8_t>(std::min<unsigned int>((std::bit_width(difference)-1)/bits, levels));
+        if (timer.level<levels)
+        {
+            timer.slot=(timer.expires>>(timer.level*bits))%slots;
+        }
+    }
+
+    auto& slot=getSlot(timer);
+    timer.index=static_cast<uint32_t>(slot.size());
+    slot.push_back(&timer);
+    if (timer.level<levels)
+    {
+        occupied[timer.level]|=uint64_t(1)<<timer.slot;
+    }
+}
+
+/************************************************************************/
+
+void Timer::Wheel::unlink(Timer& timer)
+{
+    auto& slot=getSlot(timer);
+    assert(slot[timer.index]==&timer);
+    if (timer.index+1<slot.size())
+    {
+        slot[timer.index]=slot.back();
+        slot[timer.index]->index=timer.index;
+    }
+    slot.pop_back();
+    if (slot.empty() && timer.level<levels)
+    {
+        occupied[timer.level]&=~(uint64_t(1)<<timer.slot);
+    }
+}
+
+/************************************************************************/
+
+void Timer::Wheel::cascade(std::vector<Timer*>& slot)
+{
+    std::vector<Timer*> timers;
+    timers.swap(slot);
+    for (Timer* timer : timers)
+    {
+        place(*timer);
+    }
+}
+
+/************************************************************************/
+/*
+ * Returns the next tick where something happens -- either a timer
+ * fires, or a slot on a higher level must be cascaded.
+ *
+ * Occupied slots are always ahead of the current position on their
+ * level, and anything on a lower level comes before anything on a
+ * higher level.
+ */
+
+uint64_t Timer::Wheel::nextTick() const
+{
+    for (unsigned int level=0; level<levels; level++)
+    {
+        const unsigned int shift=level*bits;
+        const unsigned int position=(current>>shift)%slots;
+        const uint64_t ahead=occupied[level] & ~((uint64_t(2)<<position)-1);
+        if (ahead!=0)
+        {
+            const uint64_t base=(current>>(shift+bits))<<(shift+bits);
+            return base | (static_cast<uint64_t>(std::countr_zero(ahead))<<shift);
+        }
+    }
+    if (!overflow.empty())
+    {
+        const unsigned int shift=levels*bits;
+        return ((current>>shift)+1)<<shift;
+    }
+    return never;
+}
+
+/************************************************************************/
+/*
+ * Process the current tick: cascade higher levels that start a new
+ * slot, then expire the level 0 slot.
+ *
+ * Expired timers are returned, so they can be woken up after we
+ * released the mutex.
+ */
+
+void Timer::Wheel::process(std::vector<std::shared_ptr<Timer>>& fired)
+{
+    if (current%(uint64_t(1)<<(levels*bits))==0)
+    {
+        cascade(overflow);
+    }
+    for (unsigned int level=levels-1; level>0; level--)
+    {
+        const unsigned int shift=level*bits;
+        if (current%(uint64_t(1)<<shift)==0)
+        {
+            const unsigned int slot=(current>>shift)%slots;
+            occupied[level]&=~(uint64_t(1)<<slot);
+            cascade(wheel[level][slot]);
+        }
+    }
+
+    const unsigned int slot=current%slots;
+    std::vector<Timer*> timers;
+    timers.swap(wheel[0][slot]);
+    occupied[0]&=~(uint64_t(1)<<slot);
+
+    const auto now=Clock::now();
+    for (Timer* timer : timers)
+    {
+        assert(timer->expires<=current);
+        if (auto locked=timer->self.lock())
+        {
+            timer->expired=true;
+            if (timer->interval!=Clock::duration::zero())
+            {
+                timer->deadline+=timer->interval;
+                if (timer->deadline<now)
+                {
+                    timer->deadline=now+timer->interval;
+                }
+                timer->expires=std::max(current+1, timer->getExpires());
+                place(*timer);
+            }
+            else
+            {
+                timer->armed=false;
+                count--;
+            }
+            fired.push_back(std::move(locked));
+        }
+        else
+        {
+            // it's being destructed, and waiting for the mutex
+            timer->armed=false;
+            count--;
+        }
+    }
+}
+
+/************************************************************************/
+
+void Timer::Wheel::run()
+{
+    auto cancellation=SteamBot::Client::getClient().cancel.registerObject(*this);
+
+    std::unique_lock<decltype(mutex)> lock(mutex);
+    while (count>0 && !cancelled)
+    {
+        sleepingUntil=nextTick();
+        assert(sleepingUntil!=never);
+        condition.wait_until(lock, fromTick(sleepingUntil), [this](){ return changed || cancelled; });
+        sleepingUntil=never;
+        changed=false;
+
+        std::vector<std::shared_ptr<Timer>> fired;
+        const auto target=toTick(Clock::now(), false);
+        while (true)
+        {
+            const auto next=nextTick();
+            if (next>target)
+            {
+                break;
+            }
+            current=next;
+            process(fired);
+        }
+        if (current<target)
+        {
+            current=target;
+        }
+
+        if (!fired.empty())
+        {
+            lock.unlock();
+            for (const auto& timer : fired)
+            {
+                timer->wakeup();
+            }
+            fired.clear();
+            lock.lock();
+        }
+    }
+    running=false;
+}
+
+/************************************************************************/
+
+void Timer::Wheel::add(Timer& timer)
+{
+    bool launch=false;
+    {
+        std::lock_guard<decltype(mutex)> lock(mutex);
+        assert(!timer.armed);
+        timer.armed=true;
+        count++;
+        // the current slot has already been processed
+        if (timer.expires<=current)
+        {
+            timer.expires=current+1;
+        }
+        place(timer);
+
+        if (timer.expires<sleepingUntil && sleepingUntil!=never)
+        {
+            changed=true;
+            condition.notify_one();
+        }
+        if (!running && !cancelled)
+        {
+            running=launch=true;
+        }
+    }
+
+    if (launch)
+    {
+        SteamBot::Client::getClient().launchFiber("Timer::Wheel", [self=shared_from_this()](){
+            self->run();
+        });
+    }
+}
+
+/************************************************************************/
+
+void Timer::Wheel::remove(Timer& timer)
+{
+    std::lock_guard<decltype(mutex)> lock(mutex);
+    if (timer.armed)
+    {
+        unlink(timer);
+        timer.armed=false;
+        count--;
+    }
+}
+
+/************************************************************************/
+
+void Timer::Wheel::cancel()
+{
+    {
+        std::lock_guard<decltype(mutex)> lock(mutex);
+        cancelled=true;
+    }
+    condition.notify_one();
+}
+
+/************************************************************************/
+
+namespace
+{
+    class WheelHolder
+    {
+    public:
+        const std::shared_ptr<Timer::Wheel> wheel=std::make_shared<Timer::Wheel>();
+    };
+}
+
+/************************************************************************/
+
+Timer::Timer(std::shared_ptr<SteamBot::WaiterBase>&& waiter_)
+    : ItemBase(std::move(waiter_)),
+      wheel(SteamBot::Client::getClient().getLocal<WheelHolder>().wheel)
+{
+}
+
+Timer::~Timer()
+{
+    wheel->remove(*this);
+}
+
+/************************************************************************/
+
+void Timer::install(std::shared_ptr<ItemBase> item)
+{
+    ItemBase::install(item);
+    self=std::dynamic_pointer_cast<Timer>(item);
+    assert(self.lock().get()==this);
+}
+
+/************************************************************************/
+
+bool Timer::isWoken() const
+{
+    return expired;
+}
+
+/************************************************************************/
+
+bool Timer::testAndClear()
+{
+    return expired.exchange(false);
+}
+
+/************************************************************************/
+
+void Timer::stop()
+{
+    wheel->remove(*this);
+    interval=Clock::duration::zero();
+    expired=false;
+}
+
+/************************************************************************/
+/*
+ * Round the deadline up to a tick boundary that's a power of two,
+ * as large as the slack allows.
+ */
+
+uint64_t Timer::getExpires() const
+{
+    uint64_t alignment=slack/resolution;
+    alignment=(alignment<=1) ? 1 : std::bit_floor(alignment);
+
+    const auto tick=Wheel::toTick(deadline, true);
+    return (tick+alignment-1)/alignment*alignment;
+}
+
+/************************************************************************/
+
+void Timer::arm(Clock::time_point deadline_, Clock::duration slack_)
+{
+    wheel->remove(*this);
+    expired=false;
+
+    deadline=deadline_;
+    slack=slack_;
+    expires=getExpires();
+
+    wheel->add(*this);
+}
+
+/************************************************************************/
+
+void Timer::setDeadline(Clock::time_point deadline_, Clock::duration slack_)
+{
+    if (deadline_==Clock::time_point::max())
+    {
+        stop();
+    }
+    else
+    {
+        interval=Clock::duration::zero();
+        arm(deadline_, slack_);
+    }
+}
+
+/************************************************************************/
+
+void Timer::setTimeout(Clock::duration duration, Clock::duration slack_)
+{
+    setDeadline(Clock::now()+duration, slack_);
+}
+
+/************************************************************************/
+
+void Timer::setInterval(Clock::duration duration, Clock::duration slack_)
+{
+    assert(duration>Clock::duration::zero());
+    interval=duration;
+    arm(Clock::now()+duration, slack_);
+}
+
+/************************************************************************/
+
+void Timer::setResolution(std::chrono::milliseconds duration)
+{
+    assert(duration.count()>0);
+    resolution=duration;
+}
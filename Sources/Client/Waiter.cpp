@@ -31,7 +31,11 @@ typedef SteamBot::Waiter Waiter;
 /************************************************************************/
 
 WaiterBase::WaiterBase() =default;
-WaiterBase::~WaiterBase() =default;
+
+WaiterBase::~WaiterBase()
+{
+    notifyCancelListeners();
+}
 
 Waiter::Waiter() =default;
 Waiter::~Waiter() =default;
@@ -43,7 +47,13 @@ ItemBase::ItemBase(std::shared_ptr<WaiterBase> waiter_)
 {
 }
 
-ItemBase::~ItemBase() =default;
+ItemBase::~ItemBase()
+{
+    if (auto locked=waiter.lock())
+    {
+        locked->removeItem(this);
+    }
+}
 
 /************************************************************************/
 
@@ -57,43 +67,131 @@ void ItemBase::wakeup()
 
 /************************************************************************/
 
+bool ItemBase::isCancelled() const
+{
+    if (auto locked=waiter.lock())
+    {
+        return locked->cancelled;
+    }
+    return true;
+}
+
+/************************************************************************/
+
 void ItemBase::install(std::shared_ptr<ItemBase>)
 {
 }
 
 /************************************************************************/
 
+void ItemBase::cancelled()
+{
+}
+
+/************************************************************************/
+
+void ItemBase::listenForCancel(std::shared_ptr<ItemBase> self)
+{
+    if (auto locked=waiter.lock())
+    {
+        locked->addCancelListener(std::move(self));
+    }
+}
+
+/************************************************************************/
+
 void WaiterBase::cancel()
 {
     if (!cancelled.exchange(true))
     {
         wakeup(nullptr);
+        notifyCancelListeners();
+    }
+}
+
+/************************************************************************/
+/*
+ * Items that are already active when they are installed never see a
+ * change that would wake them up, so put them on the ready list now.
+ *
+ * Note: subclasses often make isWoken() private.
+ */
+
+void WaiterBase::wakeupIfWoken(ItemBase& item)
+{
+    if (item.isWoken())
+    {
+        item.wakeup();
     }
 }
 
 /************************************************************************/
 
-bool WaiterBase::isWoken()
+void WaiterBase::addCancelListener(std::weak_ptr<ItemBase> item)
 {
-    bool woken=false;
-    SteamBot::erase(items, [&woken](const std::weak_ptr<ItemBase>& item){
-        auto locked=item.lock();
-        if (locked)
+    std::lock_guard<decltype(cancelMutex)> lock(cancelMutex);
+    SteamBot::erase(cancelListeners, [](const std::weak_ptr<ItemBase>& other) {
+        return other.expired();
+    });
+    cancelListeners.push_back(std::move(item));
+}
+
+/************************************************************************/
+/*
+ * Items may call back into us, so we don't keep the lock while
+ * calling them.
+ */
+
+void WaiterBase::notifyCancelListeners()
+{
+    std::vector<std::shared_ptr<ItemBase>> items;
+    {
+        std::lock_guard<decltype(cancelMutex)> lock(cancelMutex);
+        for (const auto& item : cancelListeners)
         {
-            woken|=locked->isWoken();
-            return false;
+            if (auto locked=item.lock())
+            {
+                items.push_back(std::move(locked));
+            }
         }
-        else
+    }
+    for (const auto& item : items)
+    {
+        item->cancelled();
+    }
+}
+
+/************************************************************************/
+
+void WaiterBase::removeItem(ItemBase*)
+{
+}
+
+/************************************************************************/
+/*
+ * Checks the ready list. Items stay on the list while they are
+ * active; items that have been handled since they woke us up are
+ * removed.
+ *
+ * Call with the mutex locked.
+ */
+
+bool Waiter::isWoken()
+{
+    SteamBot::erase(readyItems, [](ItemBase* item){
+        if (item->isWoken())
         {
-            return true;
+            return false;
         }
+        item->ready=false;
+        return true;
     });
-    return woken;
+    return !readyItems.empty();
 }
 
 /************************************************************************/
 
-void Waiter::wait()
+const std::vector<ItemBase*>& Waiter::wait()
 {
     std::unique_lock<decltype(mutex)> lock(mutex);
     condition.wait(lock, [this](){ return cancelled || isWoken(); });
@@ -101,6 +199,8 @@ void Waiter::wait()
     {
         throw OperationCancelledException();
     }
+    fired=readyItems;
+    return fired;
 }
 
 /************************************************************************/
@@ -116,6 +216,7 @@ bool Waiter::wait(std::chrono::milliseconds timeout)
     {
         throw OperationCancelledException();
     }
+    fired=readyItems;
     return result;
 }
 
@@ -129,6 +230,7 @@ template <typename CLOCK> bool Waiter::wait(CLOCK::time_point when)
     {
         throw OperationCancelledException();
     }
+    fired=readyItems;
     return result;
 }
 
@@ -136,9 +238,48 @@ template bool Waiter::wait<std::chrono::steady_clock>(std::chrono::steady_clock:
 
 /************************************************************************/
 
-void Waiter::wakeup(ItemBase*)
+const std::vector<ItemBase*>& Waiter::wait(const SteamBot::Deadline& deadline)
+{
+    if (!deadline.isSet())
+    {
+        return wait();
+    }
+    if (!wait<SteamBot::Deadline::Clock>(deadline.get()))
+    {
+        throw SteamBot::TimeoutException();
+    }
+    return fired;
+}
+
+/************************************************************************/
+
+/*
+ * Only the fiber owning the waiter waits on it, so we just need to
+ * notify one.
+ */
+
+void Waiter::wakeup(ItemBase* item)
+{
+    {
+        std::lock_guard<decltype(mutex)> lock(mutex);
+        if (item!=nullptr && !item->ready)
+        {
+            item->ready=true;
+            readyItems.push_back(item);
+        }
+    }
+    condition.notify_one();
+}
+
+/************************************************************************/
+
+void Waiter::removeItem(ItemBase* item)
 {
-    condition.notify_all();
+    std::lock_guard<decltype(mutex)> lock(mutex);
+    if (item->ready)
+    {
+        SteamBot::erase(readyItems, [item](ItemBase* other) { return other==item; });
+    }
 }
 
 /************************************************************************/
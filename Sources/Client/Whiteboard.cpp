@@ -20,6 +20,10 @@
 #include "Client/Whiteboard.hpp"
 #include "Vector.hpp"
 
+#include <algorithm>
+#include <atomic>
+#include <stdexcept>
+
 /************************************************************************/
 
 SteamBot::Whiteboard::WaiterBase::WaiterBase(std::shared_ptr<SteamBot::WaiterBase> waiter_, SteamBot::Whiteboard& whiteboard_)
@@ -57,24 +61,49 @@ SteamBot::Whiteboard::Whiteboard() =default;
 
 SteamBot::Whiteboard::~Whiteboard()
 {
-    assert(waiters.empty());	// must not destruct while there are still waiters!!
+    // must not destruct while there are still waiters!!
+    assert(std::all_of(waiters.begin(), waiters.end(), [](const auto& slotWaiters) { return slotWaiters.empty(); }));
+}
+
+/************************************************************************/
+/*
+ * Slots are shared by all whiteboards, and clients can run on
+ * different threads.
+ */
+
+SteamBot::Whiteboard::Slot SteamBot::Whiteboard::nextSlot()
+{
+    static std::atomic<Slot> counter{0};
+    return counter++;
+}
+
+/************************************************************************/
+
+SteamBot::Whiteboard::Slot SteamBot::Whiteboard::nextSnapshotSlot()
+{
+    static std::atomic<Slot> counter{0};
+    const Slot slot=counter++;
+    if (slot>=maxSnapshots)
+    {
+        throw std::length_error("Whiteboard: too many snapshot types; increase maxSnapshots");
+    }
+    return slot;
 }
 
 /************************************************************************/
 /*
- * Performs "callback" on all waiters for type "key".
+ * Performs "callback" on all waiters for the slot.
  *
  * This will also clean up released waiters.
  *
  * Pass a "nullptr" callback if you only want to perform the cleanup.
  */
 
-void SteamBot::Whiteboard::action(const std::type_index& key, std::function<void(std::shared_ptr<WaiterBase>)> callback)
+void SteamBot::Whiteboard::action(Slot slot, std::function<void(std::shared_ptr<WaiterBase>)> callback)
 {
-    const auto iterator=waiters.find(key);
-    if (iterator!=waiters.end())
+    if (slot<waiters.size())
     {
-        SteamBot::erase(iterator->second, [&callback](std::weak_ptr<WaiterBase>& waiter){
+        SteamBot::erase(waiters[slot], [&callback](std::weak_ptr<WaiterBase>& waiter){
             auto locked=waiter.lock();
             if (locked)
             {
@@ -86,18 +115,22 @@ void SteamBot::Whiteboard::action(const std::type_index& key, std::function<void
                 return true;
             }
         });
-        if (iterator->second.empty())
-        {
-            waiters.erase(iterator);
-        }
     }
 }
 
 /************************************************************************/
 
-void SteamBot::Whiteboard::didChange(const std::type_index& key)
+void SteamBot::Whiteboard::addWaiter(Slot slot, std::shared_ptr<WaiterBase> waiter)
+{
+    if (slot>=waiters.size()) waiters.resize(slot+1);
+    waiters[slot].emplace_back(std::move(waiter));
+}
+
+/************************************************************************/
+
+void SteamBot::Whiteboard::didChange(Slot slot)
 {
-    action(key, [](std::shared_ptr<WaiterBase> item){
+    action(slot, [](std::shared_ptr<WaiterBase> item){
         item->setChanged();
     });
 }
@@ -27,3 +27,13 @@ typedef SteamBot::Connection::Base Base;
 
 Base::Base() =default;
 Base::~Base() =default;
+
+/************************************************************************/
+
+void Base::writePackets(std::span<const ConstBytes> packets)
+{
+    for (const auto& packet : packets)
+    {
+        writePacket(packet);
+    }
+}
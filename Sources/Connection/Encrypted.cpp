@@ -284,21 +284,59 @@ void Encrypted::establishEncryption()
 
 /************************************************************************/
 
-std::span<std::byte> Encrypted::readPacket()
+/*
+ * We decrypt in place, and just narrow the packet to the plaintext.
+ */
+
+SteamBot::Connection::PacketBuffer Encrypted::readPacket()
 {
 	assert(encryptionState==EncryptionState::Encrypting);
 
-	auto bytes=connection->readPacket();
-	readBuffer=encryptionEngine->decrypt(bytes);
-	return readBuffer;
+	auto packet=connection->readPacket();
+	packet.narrow(encryptionEngine->decrypt(packet));
+	return packet;
 }
 
 /************************************************************************/
 
 void Encrypted::writePacket(std::span<const std::byte> bytes)
+{
+	writePackets(std::span<const ConstBytes>(&bytes, 1));
+}
+
+/************************************************************************/
+/*
+ * We encrypt all packets into one buffer, and pass the chunks to the
+ * transport so it can send them in one go.
+ *
+ * Writes don't overlap, so we can keep reusing the same buffer for
+ * the ciphertext.
+ */
+
+void Encrypted::writePackets(std::span<const ConstBytes> packets)
 {
 	assert(encryptionState==EncryptionState::Encrypting);
-	connection->writePacket(encryptionEngine->encrypt(bytes));
+
+	size_t size=0;
+	for (const auto& packet : packets)
+	{
+		size+=OpenSSL::AESCryptoBase::getEncryptedSize(packet.size());
+	}
+	if (writeBuffer.size()<size)
+	{
+		writeBuffer.resize(size);
+	}
+
+	writeChunks.clear();
+	std::span<std::byte> output(writeBuffer.data(), size);
+	for (const auto& packet : packets)
+	{
+		const auto bytesWritten=encryptionEngine->encrypt(packet, output);
+		writeChunks.emplace_back(output.first(bytesWritten));
+		output=output.subspan(bytesWritten);
+	}
+
+	connection->writePackets(writeChunks);
 }
 
 /************************************************************************/
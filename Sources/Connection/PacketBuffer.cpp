@@ -0,0 +1,234 @@
+/*
+ * This file is part of "Christians-Steam-Framework"
+ * Copyright (C) 2023- Christian Stieber
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 3, or (at
+ * your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; see the file LICENSE.  If not see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#include "Connection/PacketBuffer.hpp"
+
+#include <boost/fiber/mutex.hpp>
+
+#include <atomic>
+#include <array>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <bit>
+#include <cassert>
+
+/************************************************************************/
+
+typedef SteamBot::Connection::PacketBuffer PacketBuffer;
+
+/************************************************************************/
+
+class PacketBuffer::Storage
+{
+public:
+    std::atomic<unsigned int> references{0};
+    const size_t capacity;
+    const std::unique_ptr<std::byte[]> memory;
+
+public:
+    Storage(size_t capacity_)
+        : capacity(capacity_), memory(new std::byte[capacity_])
+    {
+    }
+};
+
+/************************************************************************/
+/*
+ * The pool keeps released storage in power-of-two size classes, so
+ * the steady stream of packets doesn't keep going through the
+ * allocator.
+ *
+ * Packets that are larger than the largest size class are allocated
+ * and freed as needed. We also limit the number of free buffers per
+ * size class, so a burst doesn't keep its memory forever.
+ *
+ * Storage is acquired on the Asio thread, but usually released on a
+ * client thread, so we need the mutex.
+ */
+
+namespace
+{
+    class Pool
+    {
+    private:
+        static constexpr unsigned int minimumShift=12;		// 4 KiB
+        static constexpr unsigned int maximumShift=20;		// 1 MiB
+        static constexpr size_t maximumFree=32;
+
+    private:
+        boost::fibers::mutex mutex;
+        std::array<std::vector<PacketBuffer::Storage*>, maximumShift-minimumShift+1> freeLists;
+
+    private:
+        static unsigned int getShift(size_t size)
+        {
+            const auto shift=static_cast<unsigned int>(std::bit_width(size-1));
+            return shift<minimumShift ? minimumShift : shift;
+        }
+
+    public:
+        PacketBuffer::Storage* acquire(size_t size)
+        {
+            assert(size>0);
+
+            const auto shift=getShift(size);
+            if (shift>maximumShift)
+            {
+                return new PacketBuffer::Storage(size);
+            }
+
+            auto& freeList=freeLists[shift-minimumShift];
+            {
+                std::lock_guard<decltype(mutex)> lock(mutex);
+                if (!freeList.empty())
+                {
+                    auto storage=freeList.back();
+                    freeList.pop_back();
+                    return storage;
+                }
+            }
+            return new PacketBuffer::Storage(size_t(1)<<shift);
+        }
+
+        void release(PacketBuffer::Storage* storage)
+        {
+            const auto shift=getShift(storage->capacity);
+            if (shift<=maximumShift && storage->capacity==(size_t(1)<<shift))
+            {
+                auto& freeList=freeLists[shift-minimumShift];
+                std::lock_guard<decltype(mutex)> lock(mutex);
+                if (freeList.size()<maximumFree)
+                {
+                    freeList.push_back(storage);
+                    return;
+                }
+            }
+            delete storage;
+        }
+
+    public:
+        static Pool& get()
+        {
+            static Pool& pool=*new Pool;
+            return pool;
+        }
+    };
+}
+
+/************************************************************************/
+
+PacketBuffer::PacketBuffer() =default;
+
+/************************************************************************/
+
+PacketBuffer::PacketBuffer(size_t size)
+{
+    if (size>0)
+    {
+        storage=Pool::get().acquire(size);
+        storage->references=1;
+        bytes=std::span<std::byte>(storage->memory.get(), size);
+    }
+}
+
+/************************************************************************/
+
+PacketBuffer::~PacketBuffer()
+{
+    release();
+}
+
+/************************************************************************/
+
+void PacketBuffer::release()
+{
+    if (storage!=nullptr)
+    {
+        if (--(storage->references)==0)
+        {
+            Pool::get().release(storage);
+        }
+        storage=nullptr;
+    }
+    bytes=decltype(bytes)();
+}
+
+/************************************************************************/
+
+PacketBuffer::PacketBuffer(const PacketBuffer& other)
+    : storage(other.storage), bytes(other.bytes)
+{
+    if (storage!=nullptr)
+    {
+        ++(storage->references);
+    }
+}
+
+/************************************************************************/
+
+PacketBuffer::PacketBuffer(PacketBuffer&& other)
+    : storage(other.storage), bytes(other.bytes)
+{
+    other.storage=nullptr;
+    other.bytes=decltype(other.bytes)();
+}
+
+/************************************************************************/
+
+PacketBuffer& PacketBuffer::operator=(const PacketBuffer& other)
+{
+    if (this!=&other)
+    {
+        if (other.storage!=nullptr)
+        {
+            ++(other.storage->references);
+        }
+        release();
+        storage=other.storage;
+        bytes=other.bytes;
+    }
+    return *this;
+}
+
+/************************************************************************/
+
+PacketBuffer& PacketBuffer::operator=(PacketBuffer&& other)
+{
+    if (this!=&other)
+    {
+        release();
+        storage=other.storage;
+        bytes=other.bytes;
+        other.storage=nullptr;
+        other.bytes=decltype(other.bytes)();
+    }
+    return *this;
+}
+
+/************************************************************************/
+/*
+ * The new range must be inside the current one.
+ */
+
+void PacketBuffer::narrow(std::span<std::byte> range)
+{
+    assert(range.empty() || (range.data()>=bytes.data() && range.data()+range.size()<=bytes.data()+bytes.size()));
+    bytes=range;
+}
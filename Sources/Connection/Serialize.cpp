@@ -19,11 +19,15 @@
 
 #include "Connection/Serialize.hpp"
 #include "Helpers/ProtoBuf.hpp"
+#include "Logging.hpp"
 
 #include <google/protobuf/io/zero_copy_stream_impl_lite.h>
 #include <google/protobuf/message.h>
 
 #include <boost/log/trivial.hpp>
+#include <boost/fiber/mutex.hpp>
+
+#include <map>
 
 /************************************************************************/
 
@@ -46,29 +50,119 @@ Deserializer::~Deserializer() =default;
 
 /************************************************************************/
 /*
- * Extracts information (name and content as json) from a protobuf
- * message. Used for debugging outputs.
+ * Keeps track of the sampling for message types
+ */
+
+namespace
+{
+    class Sampling
+    {
+    private:
+        class Entry
+        {
+        public:
+            unsigned int every=1;
+            unsigned int count=0;
+        };
+
+    private:
+        boost::fibers::mutex mutex;
+        std::map<std::string, Entry, std::less<>> entries;
+
+    public:
+        Sampling()
+        {
+            entries["CMsgMulti"].every=0;
+            entries["CMsgClientPICSProductInfoResponse"].every=0;
+        }
+
+    public:
+        void set(std::string_view name, unsigned int every)
+        {
+            std::lock_guard<decltype(mutex)> lock(mutex);
+            auto& entry=entries[std::string(name)];
+            entry.every=every;
+            entry.count=0;
+        }
+
+        // Returns whether this message should be rendered
+        bool check(std::string_view name)
+        {
+            std::lock_guard<decltype(mutex)> lock(mutex);
+            auto iterator=entries.find(name);
+            if (iterator==entries.end())
+            {
+                return true;
+            }
+            auto& entry=iterator->second;
+            if (entry.every==0)
+            {
+                return false;
+            }
+            return (entry.count++ % entry.every)==0;
+        }
+
+    public:
+        static Sampling& get()
+        {
+            static Sampling& sampling=*new Sampling;
+            return sampling;
+        }
+    };
+}
+
+/************************************************************************/
+
+void SteamBot::Connection::ProtobufLogging::setSampling(std::string_view name, unsigned int every)
+{
+    Sampling::get().set(name, every);
+}
+
+/************************************************************************/
+/*
+ * Renders name, size and content as json of a protobuf message, for
+ * debugging outputs.
+ *
+ * This only does the work when it's actually written to a stream,
+ * which the logging doesn't do unless the record is going to be
+ * logged.
  */
 
 namespace
 {
     class ProtobufDebug
     {
+    private:
+        const google::protobuf::MessageLite& protobufMessage;
+        const std::string_view preposition;
+        const size_t size;
+
     public:
-        std::string name;
-        boost::json::value json;
+        ProtobufDebug(const google::protobuf::MessageLite& protobufMessage_, std::string_view preposition_, size_t size_)
+            : protobufMessage(protobufMessage_), preposition(preposition_), size(size_)
+        {
+        }
 
-        ProtobufDebug(const google::protobuf::MessageLite& protobufMessage)
+    public:
+        friend std::ostream& operator<<(std::ostream& stream, const ProtobufDebug& info)
         {
-            auto message=dynamic_cast<const google::protobuf::Message*>(&protobufMessage);
-            if (message!=nullptr)
+            auto message=dynamic_cast<const google::protobuf::Message*>(&info.protobufMessage);
+            if (message==nullptr)
+            {
+                return stream << info.preposition << " " << info.size << " bytes";
+            }
+
+            const std::string& name=message->GetDescriptor()->full_name();
+            stream << name << " " << info.preposition << " " << info.size << " bytes";
+            if (Sampling::get().check(name))
             {
                 static const std::string_view typeNameKey="__type_name__";
 
-                json=SteamBot::toJson(*message);
-                name=json.at(typeNameKey).as_string();
+                auto json=SteamBot::toJson(*message);
                 json.as_object().erase(typeNameKey);
+                stream << ": " << json;
             }
+            return stream;
         }
     };
 }
@@ -87,8 +181,7 @@ size_t Serializer::storeProto(const google::protobuf::MessageLite& protobufMessa
 
     if (!noLogging)
 	{
-		const ProtobufDebug info(protobufMessage);
-		BOOST_LOG_TRIVIAL(debug) << "serializing protobuf message " << info.name << " into " << messageSize << " bytes: " << info.json;
+		STEAMBOT_LOG(Connection, debug) << "serializing protobuf message " << ProtobufDebug(protobufMessage, "into", messageSize);
 	}
 
 	return messageSize;
@@ -109,10 +202,7 @@ void Deserializer::getProto(google::protobuf::MessageLite& protobufMessage, size
 		throw ProtobufException();
 	}
 
-	{
-		const ProtobufDebug info(protobufMessage);
-		BOOST_LOG_TRIVIAL(debug) << "deserialized protobuf message " << info.name << " from " << messageSize << " bytes: " << info.json;
-	}
+	STEAMBOT_LOG(Connection, debug) << "deserialized protobuf message " << ProtobufDebug(protobufMessage, "from", messageSize);
 
 	const auto bytesRead=stream.ByteCount();
 	assert(bytesRead>=0 && static_cast<size_t>(bytesRead)<=data.size());
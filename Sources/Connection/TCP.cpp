@@ -26,6 +26,8 @@
 #include <boost/asio/write.hpp>
 #include <boost/log/trivial.hpp>
 
+#include <cstring>
+
 /************************************************************************/
 
 typedef SteamBot::Connection::TCP TCP;
@@ -76,21 +78,20 @@ namespace
         }
 
     public:
-		std::vector<std::byte> serialize() const
+		void serialize(std::span<std::byte, headerSize> bytes) const
         {
-            SteamBot::Connection::Serializer serializer;
-            serializer.store(length);
-            serializer.store(std::span<const std::byte, sizeof(magicValue)>(magicValue, sizeof(magicValue)));
-            assert(serializer.result.size()==headerSize);
-            return std::move(serializer.result);
+            const uint32_t little=boost::endian::native_to_little(length);
+            static_assert(sizeof(little)+sizeof(magicValue)==headerSize);
+            std::memcpy(bytes.data(), &little, sizeof(little));
+            std::memcpy(bytes.data()+sizeof(little), magicValue, sizeof(magicValue));
         }
 	};
 }
 
 /************************************************************************/
 
-TCP::TCP()
-	: socket(SteamBot::Asio::getIoContext())
+TCP::TCP(boost::asio::io_context& ioContext)
+	: socket(ioContext)
 {
 }
 
@@ -121,31 +122,53 @@ void TCP::disconnect()
 
 /************************************************************************/
 
-TCP::MutableBytes TCP::readPacket()
+SteamBot::Connection::PacketBuffer TCP::readPacket()
 {
 	std::array<std::byte, PacketHeader::headerSize> headerBytes;
 	auto bytesRead=boost::asio::async_read(socket, boost::asio::buffer(headerBytes), boost::fibers::asio::yield);
 	assert(bytesRead==headerBytes.size());
 
 	PacketHeader header(headerBytes);
-	readBuffer.resize(header.length);
+	PacketBuffer packet(header.length);
 	if (header.length>0)
 	{
-		/*auto bytesRead=*/ boost::asio::async_read(socket, boost::asio::buffer(readBuffer), boost::fibers::asio::yield);
+		/*auto bytesRead=*/ boost::asio::async_read(socket, boost::asio::buffer(packet.data(), packet.size()), boost::fibers::asio::yield);
 		// BOOST_LOG_TRIVIAL(debug) << "TCP: read " << bytesRead << " data bytes";
 	}
 
-	return readBuffer;
+	return packet;
 }
 
 /************************************************************************/
 
 void TCP::writePacket(TCP::ConstBytes bytes)
 {
-    auto header=PacketHeader(bytes.size()).serialize();
-    std::array<boost::asio::const_buffer, 2> buffers={ boost::asio::buffer(header), boost::asio::const_buffer(bytes.data(), bytes.size()) };
-    // BOOST_LOG_TRIVIAL(debug) << "writing packet of " << bytes.size() << " bytes";
-    boost::asio::async_write(socket, buffers, boost::fibers::asio::yield);
+    writePackets(std::span<const ConstBytes>(&bytes, 1));
+}
+
+/************************************************************************/
+/*
+ * Writes all packets with a single gathered write.
+ */
+
+void TCP::writePackets(std::span<const ConstBytes> packets)
+{
+    static_assert(std::tuple_size_v<decltype(writeHeaders)::value_type>==PacketHeader::headerSize);
+
+    writeHeaders.resize(packets.size());
+    writeBuffers.clear();
+    writeBuffers.reserve(2*packets.size());
+
+    for (size_t i=0; i<packets.size(); i++)
+    {
+        const auto& bytes=packets[i];
+        PacketHeader(bytes.size()).serialize(writeHeaders[i]);
+        writeBuffers.emplace_back(boost::asio::buffer(writeHeaders[i]));
+        writeBuffers.emplace_back(bytes.data(), bytes.size());
+    }
+
+    // BOOST_LOG_TRIVIAL(debug) << "writing " << packets.size() << " packets";
+    boost::asio::async_write(socket, writeBuffers, boost::fibers::asio::yield);
 }
 
 /************************************************************************/
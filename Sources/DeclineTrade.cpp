@@ -40,6 +40,7 @@ namespace
             url=baseUrl;
             url.segments().push_back(std::to_string(toInteger(tradeOfferId)));
             url.segments().push_back("decline");
+            priority=SteamBot::HTTPClient::Query::Priority::TimeSensitive;
         }
     };
 }
@@ -18,6 +18,7 @@
  */
 
 #include "ExecuteFibers.hpp"
+#include "FiberStack.hpp"
 
 #include <boost/log/trivial.hpp>
 #include <boost/exception/diagnostic_information.hpp>
@@ -31,7 +32,7 @@ SteamBot::ExecuteFibers::ExecuteFibers() =default;
 void SteamBot::ExecuteFibers::run(std::function<void()> function)
 {
     counter++;
-    boost::fibers::fiber([this, function=std::move(function)] {
+    boost::fibers::fiber(std::allocator_arg, SteamBot::FiberStack("ExecuteFibers"), [this, function=std::move(function)] {
         try
         {
             function();
@@ -0,0 +1,391 @@
+/*
+ * This file is part of "Christians-Steam-Framework"
+ * Copyright (C) 2023- Christian Stieber
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 3, or (at
+ * your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; see the file LICENSE.  If not see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#include "FiberStack.hpp"
+
+#include <boost/context/stack_traits.hpp>
+#include <boost/log/trivial.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cstring>
+#include <map>
+#include <mutex>
+#include <new>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#endif
+
+/************************************************************************/
+/*
+ * Note: stacks are deallocated when the fiber terminates, which
+ * happens on the scheduler and not on a fiber; we don't want to
+ * block there, so this uses std::mutex instead of the fiber mutex.
+ */
+
+typedef SteamBot::FiberStack FiberStack;
+
+/************************************************************************/
+
+class SteamBot::FiberStack::Account
+{
+public:
+    const std::string name;
+    std::atomic<size_t> stackSize{0};
+    std::atomic<uint64_t> fibers{0};
+    std::atomic<size_t> highWater{0};
+
+public:
+    Account(std::string_view name_)
+        : name(name_)
+    {
+    }
+
+public:
+    // returns true if this fiber should be measured
+    bool start(size_t size, unsigned int sampleInterval)
+    {
+        stackSize=size;
+        const auto count=fibers++;
+        return sampleInterval!=0 && count%sampleInterval==0;
+    }
+
+    void sample(size_t used)
+    {
+        size_t current=highWater;
+        while (current<used && !highWater.compare_exchange_weak(current, used))
+            ;
+    }
+};
+
+/************************************************************************/
+
+namespace
+{
+    class Pool
+    {
+    private:
+        class Stack
+        {
+        public:
+            void* memory;
+            size_t dirty;	// top part of the stack that might not be zero
+        };
+
+    private:
+        // we don't expect many names; if there are, the rest
+        // goes into one account
+        static constexpr size_t maxAccounts=256;
+
+    private:
+        std::mutex mutex;
+        std::vector<size_t> sizeClasses;
+        size_t maxFree=64;
+        std::atomic<unsigned int> sampleInterval{16};
+        std::map<size_t, std::vector<Stack>> freeStacks;
+        std::map<std::string, std::unique_ptr<FiberStack::Account>, std::less<>> accounts;
+
+    private:
+        Pool()
+        {
+            const auto minimum=boost::context::stack_traits::minimum_size();
+            for (size_t size : { 64*1024, 128*1024, 256*1024, 1024*1024 })
+            {
+                sizeClasses.push_back(std::max(size, minimum));
+            }
+        }
+
+    public:
+        static Pool& get()
+        {
+            static Pool& pool=*new Pool;
+            return pool;
+        }
+
+    private:
+        static size_t pageSize()
+        {
+            static const size_t size=boost::context::stack_traits::page_size();
+            return size;
+        }
+
+        static void* map(size_t size)
+        {
+            const size_t total=size+pageSize();
+#ifdef _WIN32
+            void* memory=::VirtualAlloc(nullptr, total, MEM_COMMIT, PAGE_READWRITE);
+            if (memory==nullptr) throw std::bad_alloc();
+            DWORD oldProtection;
+            ::VirtualProtect(memory, pageSize(), PAGE_READWRITE | PAGE_GUARD, &oldProtection);
+#else
+            void* memory=::mmap(nullptr, total, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            if (memory==MAP_FAILED) throw std::bad_alloc();
+            ::mprotect(memory, pageSize(), PROT_NONE);
+#endif
+            return memory;
+        }
+
+        static void unmap(void* memory, size_t size)
+        {
+#ifdef _WIN32
+            (void)size;
+            ::VirtualFree(memory, 0, MEM_RELEASE);
+#else
+            ::munmap(memory, size+pageSize());
+#endif
+        }
+
+        static std::byte* bottom(void* memory)
+        {
+            return static_cast<std::byte*>(memory)+pageSize();
+        }
+
+    public:
+        size_t getSize(size_t size)
+        {
+            if (size==0)
+            {
+                size=boost::context::stack_traits::default_size();
+            }
+
+            std::lock_guard<decltype(mutex)> lock(mutex);
+            auto iterator=std::lower_bound(sizeClasses.begin(), sizeClasses.end(), size);
+            if (iterator!=sizeClasses.end())
+            {
+                return *iterator;
+            }
+            return (size+pageSize()-1)/pageSize()*pageSize();
+        }
+
+        FiberStack::Account* getAccount(std::string_view name)
+        {
+            std::lock_guard<decltype(mutex)> lock(mutex);
+            auto iterator=accounts.find(name);
+            if (iterator==accounts.end())
+            {
+                if (accounts.size()>=maxAccounts)
+                {
+                    name="(other)";
+                    iterator=accounts.find(name);
+                }
+            }
+            if (iterator==accounts.end())
+            {
+                iterator=accounts.emplace(std::string(name), std::make_unique<FiberStack::Account>(name)).first;
+            }
+            return iterator->second.get();
+        }
+
+        void setSizeClasses(std::vector<size_t> sizes)
+        {
+            for (auto& size : sizes)
+            {
+                size=(size+pageSize()-1)/pageSize()*pageSize();
+            }
+            std::sort(sizes.begin(), sizes.end());
+
+            std::lock_guard<decltype(mutex)> lock(mutex);
+            sizeClasses=std::move(sizes);
+        }
+
+        void setMaxFree(size_t count)
+        {
+            std::lock_guard<decltype(mutex)> lock(mutex);
+            maxFree=count;
+        }
+
+        void setSampleInterval(unsigned int interval)
+        {
+            sampleInterval=interval;
+        }
+
+        std::vector<FiberStack::Statistics> getStatistics()
+        {
+            std::vector<FiberStack::Statistics> result;
+            std::lock_guard<decltype(mutex)> lock(mutex);
+            result.reserve(accounts.size());
+            for (const auto& item : accounts)
+            {
+                auto& statistics=result.emplace_back();
+                statistics.name=item.second->name;
+                statistics.stackSize=item.second->stackSize;
+                statistics.fibers=item.second->fibers;
+                statistics.highWater=item.second->highWater;
+            }
+            return result;
+        }
+
+    private:
+        /*
+         * Stacks grow down, and the part of a measured stack that
+         * the fiber didn't touch is still zero. We walk down from
+         * the top, one page at a time, until we find a page that is
+         * all zero; so this only looks at the part that was used.
+         */
+        static size_t measure(const std::byte* stackBottom, size_t size)
+        {
+            const size_t page=pageSize();
+            size_t used=0;
+            for (size_t offset=size; offset>=page; offset-=page)
+            {
+                const auto begin=reinterpret_cast<const uintptr_t*>(stackBottom+offset-page);
+                const auto end=begin+page/sizeof(uintptr_t);
+                const auto word=std::find_if(begin, end, [](uintptr_t value) { return value!=0; });
+                if (word==end)
+                {
+                    break;
+                }
+                used=size-(reinterpret_cast<const std::byte*>(word)-stackBottom);
+            }
+            return used;
+        }
+
+    public:
+        /*
+         * Fibers that we are going to measure need a stack that is
+         * zero below the top; new stacks come out of the kernel
+         * that way, pooled ones are cleaned here.
+         */
+        boost::context::stack_context allocate(size_t size, bool sampled)
+        {
+            Stack stack{nullptr, 0};
+            {
+                std::lock_guard<decltype(mutex)> lock(mutex);
+                auto iterator=freeStacks.find(size);
+                if (iterator!=freeStacks.end() && !iterator->second.empty())
+                {
+                    stack=iterator->second.back();
+                    iterator->second.pop_back();
+                }
+            }
+            if (stack.memory==nullptr)
+            {
+                stack.memory=map(size);
+            }
+            else if (sampled && stack.dirty>0)
+            {
+                std::memset(bottom(stack.memory)+size-stack.dirty, 0, stack.dirty);
+            }
+
+            boost::context::stack_context context;
+            context.size=size;
+            context.sp=bottom(stack.memory)+size;
+            return context;
+        }
+
+        void deallocate(boost::context::stack_context& context, FiberStack::Account& account, bool sampled) noexcept
+        {
+            const size_t size=context.size;
+            std::byte* const stackBottom=static_cast<std::byte*>(context.sp)-size;
+            void* memory=stackBottom-pageSize();
+
+            size_t dirty=size;
+            if (sampled)
+            {
+                dirty=measure(stackBottom, size);
+                account.sample(dirty);
+            }
+
+            std::unique_lock<decltype(mutex)> lock(mutex);
+            auto& stacks=freeStacks[size];
+            if (stacks.size()<maxFree && std::binary_search(sizeClasses.begin(), sizeClasses.end(), size))
+            {
+                stacks.push_back(Stack{memory, dirty});
+            }
+            else
+            {
+                lock.unlock();
+                unmap(memory, size);
+            }
+        }
+
+    public:
+        unsigned int getSampleInterval() const
+        {
+            return sampleInterval;
+        }
+    };
+}
+
+/************************************************************************/
+
+FiberStack::FiberStack(std::string_view name, size_t size_)
+    : account(Pool::get().getAccount(name)), size(Pool::get().getSize(size_))
+{
+}
+
+/************************************************************************/
+
+boost::context::stack_context FiberStack::allocate()
+{
+    auto& pool=Pool::get();
+    sampled=account->start(size, pool.getSampleInterval());
+    return pool.allocate(size, sampled);
+}
+
+/************************************************************************/
+
+void FiberStack::deallocate(boost::context::stack_context& context) noexcept
+{
+    Pool::get().deallocate(context, *account, sampled);
+}
+
+/************************************************************************/
+
+void FiberStack::setSizeClasses(std::vector<size_t> sizes)
+{
+    Pool::get().setSizeClasses(std::move(sizes));
+}
+
+/************************************************************************/
+
+void FiberStack::setMaxFree(size_t count)
+{
+    Pool::get().setMaxFree(count);
+}
+
+/************************************************************************/
+
+void FiberStack::setSampleInterval(unsigned int interval)
+{
+    Pool::get().setSampleInterval(interval);
+}
+
+/************************************************************************/
+
+std::vector<FiberStack::Statistics> FiberStack::getStatistics()
+{
+    return Pool::get().getStatistics();
+}
+
+/************************************************************************/
+
+void FiberStack::logStatistics()
+{
+    for (const auto& statistics : getStatistics())
+    {
+        BOOST_LOG_TRIVIAL(info) << "fiber stack \"" << statistics.name << "\": "
+                                << statistics.fibers << " fibers, "
+                                << statistics.highWater << " of " << statistics.stackSize << " bytes used";
+    }
+}
@@ -19,23 +19,240 @@
 
 #include "Helpers/ProtoBuf.hpp"
 
-#include <google/protobuf/util/json_util.h>
+#include <boost/beast/core/detail/base64.hpp>
+
+#include <cassert>
+#include <charconv>
+#include <cmath>
+#include <type_traits>
+#include <vector>
 
 /************************************************************************/
+/*
+ * This used to go through MessageToJsonString() and then parse the
+ * resulting string. Now, we walk the message via reflection and
+ * create the json directly.
+ */
 
-boost::json::value SteamBot::toJson(const google::protobuf::Message& message, bool full)
+namespace
 {
-    google::protobuf::util::JsonPrintOptions options;
-    options.always_print_primitive_fields=full;
-    options.always_print_enums_as_ints=true;
-    options.preserve_proto_field_names=true;
-
-    std::string jsonString;
-    if (google::protobuf::util::MessageToJsonString(message, &jsonString, options)!=google::protobuf::util::OkStatus())
+    class Converter
     {
-        throw std::runtime_error("unable to turn protobuf into json");
-    }
-    auto value=boost::json::parse(jsonString);
-    value.as_object()["__type_name__"]=message.GetTypeName();
-    return value;
+    private:
+        typedef google::protobuf::FieldDescriptor FieldDescriptor;
+        typedef google::protobuf::Reflection Reflection;
+        typedef google::protobuf::Message Message;
+
+    private:
+        const bool full;
+        const boost::json::storage_ptr& storage;
+
+    public:
+        Converter(bool full_, const boost::json::storage_ptr& storage_)
+            : full(full_), storage(storage_)
+        {
+        }
+
+    private:
+        // index<0 gets the singular value, else the repeated item
+        template <typename T> static T get(const Message& message, const FieldDescriptor* field, int index,
+                                           T (Reflection::*single)(const Message&, const FieldDescriptor*) const,
+                                           T (Reflection::*repeated)(const Message&, const FieldDescriptor*, int) const)
+        {
+            const auto reflection=message.GetReflection();
+            return index<0 ? (reflection->*single)(message, field) : (reflection->*repeated)(message, field, index);
+        }
+
+    private:
+        // The json mapping wants 64 bit integers as strings
+        template <typename T> boost::json::value makeString(T number) const
+        {
+            char buffer[32];
+            auto result=std::to_chars(buffer, buffer+sizeof(buffer), number);
+            assert(result.ec==std::errc());
+            return boost::json::string(std::string_view(buffer, static_cast<size_t>(result.ptr-buffer)), storage);
+        }
+
+        template <typename T> boost::json::value makeFloat(T number) const
+        {
+            if (std::isnan(number))
+            {
+                return boost::json::string("NaN", storage);
+            }
+            if (std::isinf(number))
+            {
+                return boost::json::string(number>0 ? "Infinity" : "-Infinity", storage);
+            }
+            if constexpr (std::is_same_v<T, float>)
+            {
+                // go through the shortest representation, so 0.1f doesn't become 0.10000000149011612
+                char buffer[32];
+                auto result=std::to_chars(buffer, buffer+sizeof(buffer), number);
+                assert(result.ec==std::errc());
+                double value=0;
+                std::from_chars(buffer, result.ptr, value);
+                return boost::json::value(value, storage);
+            }
+            else
+            {
+                return boost::json::value(number, storage);
+            }
+        }
+
+        boost::json::value makeBytes(const std::string& bytes) const
+        {
+            boost::json::string result(storage);
+            result.resize(boost::beast::detail::base64::encoded_size(bytes.size()));
+            result.resize(boost::beast::detail::base64::encode(result.data(), bytes.data(), bytes.size()));
+            return result;
+        }
+
+    private:
+        boost::json::value convertValue(const Message& message, const FieldDescriptor* field, int index) const
+        {
+            switch(field->cpp_type())
+            {
+            case FieldDescriptor::CPPTYPE_INT32:
+                return boost::json::value(get(message, field, index, &Reflection::GetInt32, &Reflection::GetRepeatedInt32), storage);
+
+            case FieldDescriptor::CPPTYPE_UINT32:
+                return boost::json::value(get(message, field, index, &Reflection::GetUInt32, &Reflection::GetRepeatedUInt32), storage);
+
+            case FieldDescriptor::CPPTYPE_INT64:
+                return makeString(get(message, field, index, &Reflection::GetInt64, &Reflection::GetRepeatedInt64));
+
+            case FieldDescriptor::CPPTYPE_UINT64:
+                return makeString(get(message, field, index, &Reflection::GetUInt64, &Reflection::GetRepeatedUInt64));
+
+            case FieldDescriptor::CPPTYPE_DOUBLE:
+                return makeFloat(get(message, field, index, &Reflection::GetDouble, &Reflection::GetRepeatedDouble));
+
+            case FieldDescriptor::CPPTYPE_FLOAT:
+                return makeFloat(get(message, field, index, &Reflection::GetFloat, &Reflection::GetRepeatedFloat));
+
+            case FieldDescriptor::CPPTYPE_BOOL:
+                return boost::json::value(get(message, field, index, &Reflection::GetBool, &Reflection::GetRepeatedBool), storage);
+
+            case FieldDescriptor::CPPTYPE_ENUM:
+                return boost::json::value(get(message, field, index, &Reflection::GetEnumValue, &Reflection::GetRepeatedEnumValue), storage);
+
+            case FieldDescriptor::CPPTYPE_STRING:
+                {
+                    std::string scratch;
+                    const auto reflection=message.GetReflection();
+                    const std::string& string=(index<0)
+                        ? reflection->GetStringReference(message, field, &scratch)
+                        : reflection->GetRepeatedStringReference(message, field, index, &scratch);
+                    if (field->type()==FieldDescriptor::TYPE_BYTES)
+                    {
+                        return makeBytes(string);
+                    }
+                    return boost::json::string(string, storage);
+                }
+
+            case FieldDescriptor::CPPTYPE_MESSAGE:
+                {
+                    const auto reflection=message.GetReflection();
+                    const Message& child=(index<0)
+                        ? reflection->GetMessage(message, field)
+                        : reflection->GetRepeatedMessage(message, field, index);
+                    return convert(child);
+                }
+
+            default:
+                assert(false);
+                return nullptr;
+            }
+        }
+
+    private:
+        // map entries are messages with "key" and "value"; the json has an object
+        boost::json::value convertMap(const Message& message, const FieldDescriptor* field) const
+        {
+            const auto reflection=message.GetReflection();
+            const auto keyField=field->message_type()->map_key();
+            const auto valueField=field->message_type()->map_value();
+
+            boost::json::object result(storage);
+            const int size=reflection->FieldSize(message, field);
+            for (int i=0; i<size; i++)
+            {
+                const Message& entry=reflection->GetRepeatedMessage(message, field, i);
+                auto key=convertValue(entry, keyField, -1);
+                if (auto string=key.if_string())
+                {
+                    result[*string]=convertValue(entry, valueField, -1);
+                }
+                else
+                {
+                    result[boost::json::serialize(key)]=convertValue(entry, valueField, -1);
+                }
+            }
+            return result;
+        }
+
+        boost::json::value convertField(const Message& message, const FieldDescriptor* field) const
+        {
+            if (field->is_map())
+            {
+                return convertMap(message, field);
+            }
+            if (field->is_repeated())
+            {
+                boost::json::array result(storage);
+                const int size=message.GetReflection()->FieldSize(message, field);
+                result.reserve(static_cast<size_t>(size));
+                for (int i=0; i<size; i++)
+                {
+                    result.push_back(convertValue(message, field, i));
+                }
+                return result;
+            }
+            return convertValue(message, field, -1);
+        }
+
+    public:
+        boost::json::object convert(const Message& message) const
+        {
+            boost::json::object result(storage);
+
+            const auto reflection=message.GetReflection();
+            if (full)
+            {
+                const auto descriptor=message.GetDescriptor();
+                for (int i=0; i<descriptor->field_count(); i++)
+                {
+                    const auto field=descriptor->field(i);
+                    if (!field->is_repeated() && !reflection->HasField(message, field))
+                    {
+                        if (field->cpp_type()==FieldDescriptor::CPPTYPE_MESSAGE || field->containing_oneof()!=nullptr)
+                        {
+                            continue;
+                        }
+                    }
+                    result[field->name()]=convertField(message, field);
+                }
+            }
+            else
+            {
+                std::vector<const FieldDescriptor*> fields;
+                reflection->ListFields(message, &fields);
+                for (const auto field : fields)
+                {
+                    result[field->name()]=convertField(message, field);
+                }
+            }
+
+            return result;
+        }
+    };
+}
+
+/************************************************************************/
+
+boost::json::value SteamBot::toJson(const google::protobuf::Message& message, bool full, boost::json::storage_ptr storage)
+{
+    auto object=Converter(full, storage).convert(message);
+    object["__type_name__"]=message.GetTypeName();
+    return object;
 }
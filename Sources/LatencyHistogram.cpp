@@ -0,0 +1,198 @@
+/*
+ * This file is part of "Christians-Steam-Framework"
+ * Copyright (C) 2023- Christian Stieber
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 3, or (at
+ * your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; see the file LICENSE.  If not see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#include "LatencyHistogram.hpp"
+
+#include <boost/log/trivial.hpp>
+
+#include <array>
+#include <atomic>
+#include <bit>
+#include <map>
+#include <memory>
+#include <mutex>
+
+/************************************************************************/
+/*
+ * Operations finish on whatever thread they run on, so this uses
+ * std::mutex and atomics, like the FiberStack accounting.
+ */
+
+typedef SteamBot::LatencyHistogram LatencyHistogram;
+
+/************************************************************************/
+
+class SteamBot::LatencyHistogram::Account
+{
+public:
+    // bucket i holds durations below 2^(i+1) microseconds
+    static constexpr size_t bucketCount=32;
+
+public:
+    const std::string name;
+    std::array<std::atomic<uint64_t>, bucketCount> buckets{};
+    std::atomic<uint64_t> timeouts{0};
+    std::atomic<uint64_t> max{0};
+
+public:
+    Account(std::string_view name_)
+        : name(name_)
+    {
+    }
+
+public:
+    void record(uint64_t microseconds, bool timedOut)
+    {
+        size_t index=std::bit_width(microseconds);
+        if (index>0) index--;
+        if (index>=bucketCount) index=bucketCount-1;
+        buckets[index]++;
+
+        if (timedOut)
+        {
+            timeouts++;
+        }
+
+        uint64_t current=max;
+        while (current<microseconds && !max.compare_exchange_weak(current, microseconds))
+            ;
+    }
+
+public:
+    LatencyHistogram::Statistics getStatistics() const
+    {
+        LatencyHistogram::Statistics statistics;
+        statistics.name=name;
+        statistics.timeouts=timeouts;
+        statistics.max=std::chrono::microseconds(max);
+
+        std::array<uint64_t, bucketCount> counts;
+        for (size_t i=0; i<bucketCount; i++)
+        {
+            counts[i]=buckets[i];
+            statistics.count+=counts[i];
+        }
+
+        auto percentile=[&](uint64_t percent) {
+            const uint64_t rank=(statistics.count*percent+99)/100;
+            uint64_t seen=0;
+            for (size_t i=0; i<bucketCount; i++)
+            {
+                seen+=counts[i];
+                if (seen>=rank)
+                {
+                    return std::min(std::chrono::microseconds(uint64_t(2)<<i), statistics.max);
+                }
+            }
+            return statistics.max;
+        };
+
+        if (statistics.count>0)
+        {
+            statistics.p50=percentile(50);
+            statistics.p90=percentile(90);
+            statistics.p99=percentile(99);
+        }
+        return statistics;
+    }
+};
+
+/************************************************************************/
+
+namespace
+{
+    class Registry
+    {
+    private:
+        std::mutex mutex;
+        std::map<std::string, std::unique_ptr<LatencyHistogram::Account>, std::less<>> accounts;
+
+    private:
+        Registry() =default;
+
+    public:
+        static Registry& get()
+        {
+            static Registry& registry=*new Registry;
+            return registry;
+        }
+
+    public:
+        LatencyHistogram::Account* getAccount(std::string_view name)
+        {
+            std::lock_guard<decltype(mutex)> lock(mutex);
+            auto iterator=accounts.find(name);
+            if (iterator==accounts.end())
+            {
+                iterator=accounts.emplace(std::string(name), std::make_unique<LatencyHistogram::Account>(name)).first;
+            }
+            return iterator->second.get();
+        }
+
+        std::vector<LatencyHistogram::Statistics> getStatistics()
+        {
+            std::vector<LatencyHistogram::Statistics> result;
+            std::lock_guard<decltype(mutex)> lock(mutex);
+            result.reserve(accounts.size());
+            for (const auto& item : accounts)
+            {
+                result.push_back(item.second->getStatistics());
+            }
+            return result;
+        }
+    };
+}
+
+/************************************************************************/
+
+LatencyHistogram::LatencyHistogram(std::string_view name)
+    : account(Registry::get().getAccount(name))
+{
+}
+
+/************************************************************************/
+
+void LatencyHistogram::record(Clock::duration duration, bool timedOut)
+{
+    const auto microseconds=std::chrono::duration_cast<std::chrono::microseconds>(duration).count();
+    account->record(microseconds>0 ? static_cast<uint64_t>(microseconds) : 0, timedOut);
+}
+
+/************************************************************************/
+
+std::vector<LatencyHistogram::Statistics> LatencyHistogram::getStatistics()
+{
+    return Registry::get().getStatistics();
+}
+
+/************************************************************************/
+
+void LatencyHistogram::logStatistics()
+{
+    for (const auto& statistics : getStatistics())
+    {
+        BOOST_LOG_TRIVIAL(info) << "latency \"" << statistics.name << "\": "
+                                << statistics.count << " calls, "
+                                << statistics.timeouts << " timeouts, p50 "
+                                << statistics.p50.count() << "us, p90 "
+                                << statistics.p90.count() << "us, p99 "
+                                << statistics.p99.count() << "us, max "
+                                << statistics.max.count() << "us";
+    }
+}
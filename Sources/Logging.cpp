@@ -23,6 +23,142 @@
 #include <boost/log/utility/setup/file.hpp>
 #include <boost/log/utility/setup/common_attributes.hpp>
 #include <boost/log/trivial.hpp>
+#include <boost/log/expressions.hpp>
+#include <boost/algorithm/string/split.hpp>
+#include <boost/algorithm/string/classification.hpp>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstdlib>
+#include <string_view>
+#include <vector>
+
+/************************************************************************/
+
+typedef SteamBot::Logging::Channel Channel;
+typedef boost::log::trivial::severity_level severity_level;
+
+/************************************************************************/
+
+namespace
+{
+    constexpr std::array<std::string_view, 2> channelNames{ "general", "connection" };
+
+    std::array<std::atomic<severity_level>, channelNames.size()> severities{
+        severity_level::debug,
+        severity_level::info
+    };
+}
+
+/************************************************************************/
+
+void SteamBot::Logging::setSeverity(Channel channel, severity_level severity)
+{
+    severities[static_cast<unsigned int>(channel)]=severity;
+}
+
+/************************************************************************/
+
+void SteamBot::Logging::setSeverity(severity_level severity)
+{
+    for (auto& item : severities)
+    {
+        item=severity;
+    }
+}
+
+/************************************************************************/
+
+bool SteamBot::Logging::isEnabled(Channel channel, severity_level severity)
+{
+    return severity>=severities[static_cast<unsigned int>(channel)].load(std::memory_order_relaxed);
+}
+
+/************************************************************************/
+
+SteamBot::Logging::Logger& SteamBot::Logging::getLogger(Channel channel)
+{
+    static Logger connection(boost::log::keywords::channel=Channel::Connection);
+    switch(channel)
+    {
+    case Channel::Connection:
+        return connection;
+
+    case Channel::General:
+        break;
+    }
+    static Logger general(boost::log::keywords::channel=Channel::General);
+    return general;
+}
+
+/************************************************************************/
+/*
+ * Records from STEAMBOT_LOG() have already been checked; everything
+ * else comes from BOOST_LOG_TRIVIAL().
+ */
+
+static bool filter(const boost::log::attribute_value_set& values)
+{
+    if (values.count("Channel")!=0)
+    {
+        return true;
+    }
+    if (auto severity=values[boost::log::trivial::severity])
+    {
+        return SteamBot::Logging::isEnabled(Channel::General, *severity);
+    }
+    return true;
+}
+
+/************************************************************************/
+/*
+ * Parses the STEAMBOT_LOG environment variable
+ */
+
+static void configure()
+{
+    const char* config=std::getenv("STEAMBOT_LOG");
+    if (config==nullptr)
+    {
+        return;
+    }
+
+    std::vector<std::string> items;
+    boost::algorithm::split(items, config, boost::algorithm::is_any_of(","));
+    for (std::string_view item : items)
+    {
+        std::string_view channelName;
+        auto equals=item.find('=');
+        if (equals!=std::string_view::npos)
+        {
+            channelName=item.substr(0, equals);
+            item.remove_prefix(equals+1);
+        }
+
+        severity_level severity;
+        if (!boost::log::trivial::from_string(item.data(), item.size(), severity))
+        {
+            BOOST_LOG_TRIVIAL(error) << "STEAMBOT_LOG: unknown severity \"" << item << "\"";
+            continue;
+        }
+
+        if (channelName.empty())
+        {
+            SteamBot::Logging::setSeverity(severity);
+        }
+        else
+        {
+            auto iterator=std::find(channelNames.begin(), channelNames.end(), channelName);
+            if (iterator==channelNames.end())
+            {
+                BOOST_LOG_TRIVIAL(error) << "STEAMBOT_LOG: unknown channel \"" << channelName << "\"";
+                continue;
+            }
+            SteamBot::Logging::setSeverity(static_cast<Channel>(iterator-channelNames.begin()), severity);
+        }
+    }
+}
 
 /************************************************************************/
 
@@ -41,6 +177,9 @@ void SteamBot::Logging::init()
     );
 
     boost::log::add_common_attributes();
+    boost::log::core::get()->set_filter(&filter);
 
     BOOST_LOG_TRIVIAL(info) << "============================== program launch ==============================";
+
+    configure();
 }
@@ -31,6 +31,7 @@
 
 #include "Client/Module.hpp"
 #include "Client/Signal.hpp"
+#include "Client/Timer.hpp"
 #include "Modules/TradeOffers.hpp"
 #include "Modules/AutoLoadTradeoffers.hpp"
 
@@ -77,24 +78,30 @@ namespace
 
 void AutoLoadTradeoffersModule::run(SteamBot::Client&)
 {
+    auto timer=SteamBot::Timer::createWaiter(*waiter);
+
     while (true)
     {
         stateChangeSignal->testAndClear();
 
         if (!enabled || reload.count()==0)
         {
-            waiter->wait();
+            timer->stop();
         }
         else
         {
-            if (!waiter->wait(reload))
+            timer->setTimeout(reload, std::chrono::seconds(5));
+        }
+
+        waiter->wait();
+
+        if (timer->testAndClear())
+        {
+            if (enabled)
             {
-                if (enabled)
-                {
-                    reload=decltype(reload)::zero();
-                    SteamBot::TradeOffers::getIncoming();
-                    BOOST_LOG_TRIVIAL(debug) << "AutoLoadTradeoffersModule: loaded tradeoffers";
-                }
+                reload=decltype(reload)::zero();
+                SteamBot::TradeOffers::getIncoming();
+                BOOST_LOG_TRIVIAL(debug) << "AutoLoadTradeoffersModule: loaded tradeoffers";
             }
         }
 
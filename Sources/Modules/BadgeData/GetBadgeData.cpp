@@ -153,7 +153,7 @@ namespace
 void GetBadgeDataModule::init(SteamBot::Client& client)
 {
     ownedGamesWaiter=client.whiteboard.createWaiter<OwnedGames::Ptr>(*waiter);
-    updateBadgeWaiter=client.messageboard.createWaiter<UpdateBadge>(*waiter);
+    updateBadgeWaiter=client.messageboard.createWaiter<UpdateBadge>(*waiter, SteamBot::Messageboard::QueuePolicy::coalesce());
     inventoryNotificationWaiter=client.messageboard.createWaiter<InventoryNotification>(*waiter);
     gameChangedWaiter=client.messageboard.createWaiter<GameChanged>(*waiter);
     enableWaiter=client.whiteboard.createWaiter<Enable::Ptr<Enable>>(*waiter);
@@ -178,7 +178,9 @@ bool GetBadgeDataModule::getURL(boost::urls::url url, BadgeData& badgeData, bool
 {
     auto request=std::make_shared<Request>();
     request->queryMaker=[&url]() {
-        return std::make_unique<SteamBot::HTTPClient::Query>(boost::beast::http::verb::get, std::move(url));
+        auto query=std::make_unique<SteamBot::HTTPClient::Query>(boost::beast::http::verb::get, std::move(url));
+        query->priority=SteamBot::HTTPClient::Query::Priority::Bulk;
+        return query;
     };
 
     auto response=SteamBot::Modules::WebSession::makeQuery(std::move(request));
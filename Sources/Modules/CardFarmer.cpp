@@ -18,6 +18,7 @@
  */
 
 #include "Client/Module.hpp"
+#include "Client/Timer.hpp"
 #include "Modules/BadgeData.hpp"
 #include "Modules/OwnedGames.hpp"
 #include "Modules/CardFarmer.hpp"
@@ -499,18 +500,23 @@ void CardFarmerModule::init(SteamBot::Client& client)
 
 void CardFarmerModule::run(SteamBot::Client&)
 {
+    auto timer=SteamBot::Timer::createWaiter(*waiter);
+
     waitForLogin();
 
     while (true)
     {
         if (playing.empty())
         {
+            timer->stop();
             waiter->wait();
             lastBadgeUpdate=std::chrono::steady_clock::now();
         }
         else
         {
-            if (!waiter->wait<std::chrono::steady_clock>(lastBadgeUpdate+forceBadgeUpdateTime))
+            timer->setDeadline(lastBadgeUpdate+forceBadgeUpdateTime, std::chrono::minutes(1));
+            waiter->wait();
+            if (timer->testAndClear())
             {
                 BOOST_LOG_TRIVIAL(info) << "CardFarmer: forced bagde update";
                 for (auto appId : playing)
@@ -23,19 +23,219 @@
 #include "Modules/Connection_Internal.hpp"
 #include "Connection/Message.hpp"
 
-#include <boost/fiber/barrier.hpp>
 #include <boost/exception/diagnostic_information.hpp>
 #include <boost/log/trivial.hpp>
 
 #include "Steam/ProtoBuf/steammessages_base.hpp"
 #include "Steam/ProtoBuf/steammessages_clientserver_login.hpp"
 
+#include <cassert>
+#include <deque>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+
 /************************************************************************/
 
 typedef SteamBot::Modules::Connection::Internal::HandlerBase HandlerBase;
+typedef SteamBot::Modules::Connection::Internal::JobRouter JobRouter;
+typedef SteamBot::Modules::Connection::JobWaiterBase JobWaiterBase;
 typedef SteamBot::Modules::Connection::Messageboard::SendSteamMessage SendSteamMessage;
 typedef SteamBot::Modules::Connection::Whiteboard::ConnectionStatus ConnectionStatus;
 
+/************************************************************************/
+/*
+ * The JobRouter maps jobids to the JobWaiters that want the
+ * responses.
+ */
+
+class SteamBot::Modules::Connection::Internal::JobRouter
+{
+private:
+    class Entry
+    {
+    public:
+        const JobWaiterBase* owner;		// still valid while the job destructs
+        std::weak_ptr<JobWaiterBase> job;
+    };
+
+    std::unordered_map<uint64_t, Entry> jobs;
+
+public:
+    JobRouter() =default;
+    ~JobRouter() =default;
+
+public:
+    // jobids must be unique; we can't route to two waiters
+    void add(std::shared_ptr<JobWaiterBase> job)
+    {
+        const JobWaiterBase* owner=job.get();
+        if (!jobs.try_emplace(job->jobId, Entry{owner, std::move(job)}).second)
+        {
+            throw std::logic_error("JobRouter: duplicate jobid "+std::to_string(owner->jobId));
+        }
+    }
+
+    void remove(const JobWaiterBase* job)
+    {
+        auto iterator=jobs.find(job->jobId);
+        if (iterator!=jobs.end() && iterator->second.owner==job)
+        {
+            jobs.erase(iterator);
+        }
+    }
+
+    // returns true if the message went to a JobWaiter
+    bool route(const HandlerBase* handler, std::shared_ptr<SteamBot::DestructMonitor>& message) const
+    {
+        if (!jobs.empty())
+        {
+            const auto jobId=handler->getJobTarget(*message);
+            if (jobId!=HandlerBase::noJobId)
+            {
+                auto iterator=jobs.find(jobId);
+                if (iterator!=jobs.end())
+                {
+                    if (auto job=iterator->second.job.lock())
+                    {
+                        if (job->accepts(*message))
+                        {
+                            job->deliver(std::move(message));
+                            return true;
+                        }
+                    }
+                }
+            }
+        }
+        return false;
+    }
+};
+
+/************************************************************************/
+/*
+ * Packets from the network are decoded as soon as they arrive, and
+ * queued here in the order they came in.
+ *
+ * Some messages must be fully processed before anything that came
+ * after them is posted:
+ *   - for CMsgMulti, the messages are not interleaved with
+ *     later messages from the network connection
+ *   - for CMsgClientLogonResponse, the message is fully
+ *     processed before a potential connection close
+ *     is detected and the client is shut down
+ *
+ * When we post one of these, delivery stops after it until the
+ * message is destructed (i.e. all recipients have received and
+ * processed it). The connection module keeps reading, decoding and
+ * writing in the meantime; the destruct callback wakes it up to post
+ * the rest of the queue, or to notice that we are idle now and it can
+ * finish a closed connection.
+ */
+
+namespace
+{
+    class Delivery : public SteamBot::WaiterBase::ItemBase, public SteamBot::DestructMonitor::DestructCallback
+    {
+    private:
+        class Pending
+        {
+        public:
+            const HandlerBase* handler;
+            std::shared_ptr<SteamBot::DestructMonitor> message;
+        };
+
+    private:
+        std::weak_ptr<Delivery> self;
+        const std::shared_ptr<const JobRouter> router;
+        std::deque<Pending> pending;
+
+        // number of posted messages that we are waiting for
+        unsigned int blockedBy=0;
+
+        // the last of them is gone; the connection module might
+        // have been waiting for us to become idle
+        bool released=false;
+
+    public:
+        Delivery(std::shared_ptr<SteamBot::WaiterBase> waiter_, std::shared_ptr<const JobRouter> router_)
+            : ItemBase(std::move(waiter_)), router(std::move(router_))
+        {
+        }
+
+        virtual ~Delivery() =default;
+
+    public:
+        virtual void install(std::shared_ptr<ItemBase> item) override
+        {
+            self=std::dynamic_pointer_cast<Delivery>(item);
+            assert(!self.expired());
+        }
+
+        virtual bool isWoken() const override
+        {
+            return blockedBy==0 && (released || !pending.empty());
+        }
+
+    private:
+        virtual void call(const SteamBot::DestructMonitor*) override
+        {
+            assert(blockedBy>0);
+            if (--blockedBy==0)
+            {
+                released=true;
+                wakeup();
+            }
+        }
+
+    private:
+        static bool isOrdered(const SteamBot::DestructMonitor& message)
+        {
+            const auto& messageType=typeid(message);
+            return messageType==typeid(Steam::CMsgMultiMessageType) || messageType==typeid(Steam::CMsgClientLogonResponseMessageType);
+        }
+
+    public:
+        bool isIdle() const
+        {
+            return blockedBy==0 && pending.empty();
+        }
+
+        void queue(const HandlerBase* handler, std::shared_ptr<SteamBot::DestructMonitor> message)
+        {
+            pending.emplace_back(handler, std::move(message));
+        }
+
+        void send(const HandlerBase* handler, std::shared_ptr<SteamBot::DestructMonitor> message)
+        {
+            if (isOrdered(*message))
+            {
+                // the message may already be gone when send() returns
+                blockedBy++;
+                message->destructCallback=self;
+            }
+            if (!router->route(handler, message))
+            {
+                handler->send(std::move(message));
+            }
+        }
+
+        void deliver()
+        {
+            released=false;
+            while (blockedBy==0 && !pending.empty())
+            {
+                auto item=std::move(pending.front());
+                pending.pop_front();
+                send(item.handler, std::move(item.message));
+                if (blockedBy>0 && !pending.empty())
+                {
+                    BOOST_LOG_TRIVIAL(debug) << "holding " << pending.size() << " messages";
+                }
+            }
+        }
+    };
+}
+
 /************************************************************************/
 
 namespace
@@ -44,7 +244,12 @@ namespace
     {
     private:
         SteamBot::Messageboard::WaiterType<SendSteamMessage> sendMessageWaiter;
+        std::shared_ptr<Delivery> delivery;
+
+    public:
+        const std::shared_ptr<JobRouter> router=std::make_shared<JobRouter>();
 
+    private:
         std::unordered_map<SteamBot::Connection::Message::Type, std::unique_ptr<HandlerBase>> handlers;
 
     public:
@@ -62,6 +267,9 @@ namespace
     public:
         void add(SteamBot::Connection::Message::Type, std::unique_ptr<HandlerBase>&&);
 
+    private:
+        std::pair<const HandlerBase*, std::shared_ptr<SteamBot::DestructMonitor>> decodePacket(std::span<const std::byte>) const;
+
     public:
         void handlePacket(std::span<const std::byte>) const;
     };
@@ -105,7 +313,7 @@ void ConnectionModule::writePackets(SteamBot::Connections::ConnectResult::elemen
 
 /************************************************************************/
 
-void ConnectionModule::handlePacket(std::span<const std::byte> bytes) const
+std::pair<const HandlerBase*, std::shared_ptr<SteamBot::DestructMonitor>> ConnectionModule::decodePacket(std::span<const std::byte> bytes) const
 {
     const auto messageType=SteamBot::Connection::Message::Header::Base::peekMessgeType(bytes);
     auto iterator=handlers.find(messageType);
@@ -113,14 +321,31 @@ void ConnectionModule::handlePacket(std::span<const std::byte> bytes) const
     {
         BOOST_LOG_TRIVIAL(info) << "received message type " << SteamBot::enumToStringAlways(messageType);
         auto handler=iterator->second.get();
-        handler->handle(bytes);
+        return std::make_pair(handler, handler->decode(bytes));
     }
     else
     {
         BOOST_LOG_TRIVIAL(info) << "ignoring message type " << SteamBot::enumToStringAlways(messageType);
+        return std::make_pair(nullptr, nullptr);
     }
 }
 
+/************************************************************************/
+/*
+ * This posts a packet right away, without going through the
+ * delivery queue. It's used for the contents of a CMsgMulti, which
+ * is still blocking the queue while it's being unpacked; ordered
+ * messages inside it will block the queue as well.
+ */
+
+void ConnectionModule::handlePacket(std::span<const std::byte> bytes) const
+{
+    auto [handler, message]=decodePacket(bytes);
+    if (handler!=nullptr)
+    {
+        delivery->send(handler, std::move(message));
+    }
+}
 
 /************************************************************************/
 
@@ -131,10 +356,15 @@ void ConnectionModule::readPackets(SteamBot::Connections::ConnectResult::element
         auto packet=connection->readPacket();
         if (packet.empty())
         {
-            return;
+            break;
+        }
+        auto [handler, message]=decodePacket(packet);
+        if (handler!=nullptr)
+        {
+            delivery->queue(handler, std::move(message));
         }
-        handlePacket(packet);
     }
+    delivery->deliver();
 }
 
 /************************************************************************/
@@ -142,6 +372,7 @@ void ConnectionModule::readPackets(SteamBot::Connections::ConnectResult::element
 void ConnectionModule::init(SteamBot::Client& client)
 {
     sendMessageWaiter=client.messageboard.createWaiter<SendSteamMessage>(*waiter);
+    delivery=waiter->createWaiter<Delivery>(router);
 }
 
 /************************************************************************/
@@ -171,14 +402,23 @@ void ConnectionModule::body()
     {
         waiter->wait();
 
-        writePackets(connection.get());
-        readPackets(connection.get());
+        if (waiter->hasFired(sendMessageWaiter.get()))
+        {
+            writePackets(connection.get());
+        }
+        if (waiter->hasFired(connection.get()) || waiter->hasFired(delivery.get()))
+        {
+            readPackets(connection.get());
+        }
 
         typedef SteamBot::Connections::Connection::Status Status;
         const auto status=connection->getStatus();
         if (status==Status::GotEOF || status==Status::Error)
         {
-            break;
+            if (delivery->isIdle())
+            {
+                break;
+            }
         }
         else if (status==Status::Connecting)
         {
@@ -245,63 +485,66 @@ void HandlerBase::add(SteamBot::Connection::Message::Type type, std::unique_ptr<
 
 /************************************************************************/
 
-static void waitMessageDestruct(std::shared_ptr<SteamBot::DestructMonitor>& message)
+void SteamBot::Modules::Connection::handlePacket(std::span<const std::byte> bytes)
 {
-    class Callback : public SteamBot::DestructMonitor::DestructCallback
+    SteamBot::Client::getClient().getModule<ConnectionModule>()->handlePacket(bytes);
+}
+
+/************************************************************************/
+
+JobWaiterBase::JobWaiterBase(std::shared_ptr<SteamBot::WaiterBase>&& waiter_, const SteamBot::JobID& jobId_)
+    : ItemBase(std::move(waiter_)), jobId(jobId_.getValue())
+{
+}
+
+/************************************************************************/
+
+JobWaiterBase::~JobWaiterBase()
+{
+    if (auto locked=router.lock())
     {
-    public:
-        virtual ~Callback() =default;
+        locked->remove(this);
+    }
+}
 
-    private:
-        boost::fibers::barrier barrier{2};
+/************************************************************************/
 
-    private:
-        virtual void call(const SteamBot::DestructMonitor*) override
-        {
-            barrier.wait();
-        }
+void JobWaiterBase::install(std::shared_ptr<ItemBase> item)
+{
+    ItemBase::install(item);
 
-    public:
-        void wait()
-        {
-            barrier.wait();
-        }
-    };
+    auto job=std::dynamic_pointer_cast<JobWaiterBase>(item);
+    assert(job.get()==this);
 
-    auto callback=std::make_shared<Callback>();
-    message->destructCallback=callback;
-    message.reset();
-    callback->wait();
+    auto locked=SteamBot::Client::getClient().getModule<ConnectionModule>()->router;
+    locked->add(std::move(job));
+    router=std::move(locked);
 }
 
 /************************************************************************/
-/*
- * This deserializes the packet, and posts it to the messageboard.
- *
- * For specific message types, it will wait until the message is
- * destructed (i.. all recipients have received and processed
- * the message). This ensures that
- *   - for CMsgMulti, the messages are not interlaved with
- *     later messages from the network connection
- *   - for CMsgClientLogonResponse, the message is fully
- *     processed before a potential connection close
- *     is detected and the client is shut down
- */
 
-void HandlerBase::handle(SteamBot::Connection::Base::ConstBytes bytes) const
+bool JobWaiterBase::isWoken() const
 {
-    auto message=send(bytes);
-    const auto& messageType=typeid(*message);
-    if (messageType==typeid(Steam::CMsgMultiMessageType) ||
-        messageType==typeid(Steam::CMsgClientLogonResponseMessageType))
-    {
-        waitMessageDestruct(message);
-    }
+    return !responses.empty();
 }
 
 /************************************************************************/
 
-void SteamBot::Modules::Connection::handlePacket(std::span<const std::byte> bytes)
+void JobWaiterBase::deliver(std::shared_ptr<SteamBot::DestructMonitor> message)
 {
-    SteamBot::Client::getClient().getModule<ConnectionModule>()->handlePacket(bytes);
+    responses.push_back(std::move(message));
+    wakeup();
+}
+
+/************************************************************************/
+
+std::shared_ptr<SteamBot::DestructMonitor> JobWaiterBase::fetchBase()
+{
+    std::shared_ptr<SteamBot::DestructMonitor> result;
+    if (!responses.empty())
+    {
+        result=std::move(responses.front());
+        responses.pop_front();
+    }
+    return result;
 }
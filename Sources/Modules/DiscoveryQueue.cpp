@@ -24,6 +24,7 @@
 
 /************************************************************************/
 
+#include "Client/Client.hpp"
 #include "Modules/WebSession.hpp"
 #include "Modules/DiscoveryQueue.hpp"
 #include "Helpers/URLs.hpp"
@@ -166,14 +167,19 @@ static bool performClear()
 
 bool SteamBot::DiscoveryQueue::clear()
 {
-    static thread_local boost::fibers::mutex mutex;
-    static thread_local bool lastResult=false;
+    struct ClearState
+    {
+        boost::fibers::mutex mutex;
+        bool lastResult=false;
+    };
+
+    auto& state=SteamBot::Client::getClient().getLocal<ClearState>();
 
-    std::unique_lock<decltype(mutex)> lock(mutex, std::try_to_lock);
+    std::unique_lock<decltype(state.mutex)> lock(state.mutex, std::try_to_lock);
     if (!lock.owns_lock())
     {
         lock.lock();
-        return lastResult;
+        return state.lastResult;
     }
-    return lastResult=performClear();
+    return state.lastResult=performClear();
 }
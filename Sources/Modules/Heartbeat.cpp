@@ -20,6 +20,7 @@
 #include "Modules/Connection.hpp"
 #include "Modules/Heartbeat.hpp"
 #include "Client/Module.hpp"
+#include "Client/Timer.hpp"
 #include "Modules/Login.hpp"
 #include "Steam/ProtoBuf/steammessages_clientserver_login.hpp"
 
@@ -46,24 +47,25 @@ void HeartbeatModule::run(SteamBot::Client& client)
     typedef SteamBot::Modules::Connection::Whiteboard::LastMessageSent LastMessageSent;
     std::shared_ptr<SteamBot::Whiteboard::Waiter<LastMessageSent>> lastMessageSent;
     lastMessageSent=waiter->createWaiter<decltype(lastMessageSent)::element_type>(client.whiteboard);
+    auto timer=SteamBot::Timer::createWaiter(*waiter);
 
     waitForLogin();
 
     while (true)
     {
-        bool timeout=false;
         {
             auto delay=client.whiteboard.has<SteamBot::Modules::Login::Whiteboard::HeartbeatInterval>();
             if (delay!=nullptr)
             {
-                timeout=!waiter->wait(*delay);
+                timer->setTimeout(*delay, *delay/10);
             }
             else
             {
-                waiter->wait();
+                timer->stop();
             }
         }
-        if (timeout)
+        waiter->wait();
+        if (timer->testAndClear())
         {
             auto message=std::make_unique<Steam::CMsgClientHeartBeatMessageType>();
             SteamBot::Modules::Connection::Messageboard::SendSteamMessage::send(std::move(message));
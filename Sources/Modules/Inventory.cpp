@@ -281,7 +281,10 @@ std::shared_ptr<const Response> InventoryModule::makeInventoryQuery(const boost:
 {
     auto request=std::make_shared<Request>();
     request->queryMaker=[&url](){
-        return std::make_unique<SteamBot::HTTPClient::Query>(boost::beast::http::verb::get, url);
+        auto query=std::make_unique<SteamBot::HTTPClient::Query>(boost::beast::http::verb::get, url);
+        query->priority=SteamBot::HTTPClient::Query::Priority::Bulk;
+        query->streamJson=true;
+        return query;
     };
 
     // we use a more restrictive rate-limiting, but independent of the
@@ -39,8 +39,21 @@ namespace
 {
     class InventoryNotificationModule : public SteamBot::Client::Module
     {
+    private:
+        class Pending
+        {
+        public:
+            std::shared_ptr<const ClientNotification> notification;
+            std::shared_ptr<SteamBot::Inventory::ItemKey> itemKey;
+        };
+
     private:
         SteamBot::Messageboard::WaiterType<ClientNotification> clientNotificationWaiter;
+        std::vector<Pending> pending;
+
+    private:
+        void processPending();
+        void processResponse(Pending&, const GetInventoryItemsWithDescriptionsInfo::ResultType&);
 
     public:
         void handle(std::shared_ptr<const ClientNotification>);
@@ -89,65 +102,108 @@ void InventoryNotificationModule::handle(std::shared_ptr<const ClientNotificatio
     {
         BOOST_LOG_TRIVIAL(debug) << "client notification body: " << notification->body;
 
-        auto& client=SteamBot::Client::getClient();
-
         auto itemKey=std::make_shared<SteamBot::Inventory::ItemKey>(notification->body);
+        pending.emplace_back(std::move(notification), std::move(itemKey));
+    }
+}
 
-        std::shared_ptr<GetInventoryItemsWithDescriptionsInfo::ResultType> response;
-        {
-            GetInventoryItemsWithDescriptionsInfo::RequestType request;
-            {
-                auto steamId=client.whiteboard.get<SteamBot::Modules::Login::Whiteboard::SteamID>();
-                request.set_steamid(steamId.getValue());
-            }
-            request.set_language("english");
-            request.set_appid(static_cast<uint32_t>(SteamBot::toInteger(itemKey->appId)));
-            request.set_contextid(static_cast<uint32_t>(SteamBot::toInteger(itemKey->contextId)));
-            request.set_get_descriptions(true);
-            auto filters=request.mutable_filters();
-            filters->add_assetids(static_cast<uint64_t>(SteamBot::toInteger(itemKey->assetId)));
-
-            response=SteamBot::Modules::UnifiedMessageClient::execute<GetInventoryItemsWithDescriptionsInfo::ResultType>("Econ.GetInventoryItemsWithDescriptions#1", std::move(request));
-        }
+/************************************************************************/
+/*
+ * Notifications tend to arrive in bursts, so we query the items
+ * for all notifications that we have at the same time.
+ *
+ * A failed query only loses its own notification.
+ */
 
-        std::shared_ptr<const SteamBot::AssetData::AssetInfo> info;
-        if (response->assets_size()==1)
-        {
-            assert(response->descriptions_size()==1);
+void InventoryNotificationModule::processPending()
+{
+    if (pending.empty())
+    {
+        return;
+    }
 
-            auto json=SteamBot::toJson(dynamic_cast<const google::protobuf::Message&>(response->descriptions(0)));
-            auto assetKey=std::make_shared<SteamBot::AssetKey>(json);
-            info=SteamBot::AssetData::query(assetKey);
-            if (!info)
-            {
-                info=SteamBot::AssetData::store(json);
-                if (!info)
-                {
-                    info=SteamBot::AssetData::query(assetKey);
-                }
-            }
-        }
-        else if (response->missing_assets_size()==1)
+    auto& client=SteamBot::Client::getClient();
+    const auto steamId=client.whiteboard.get<SteamBot::Modules::Login::Whiteboard::SteamID>();
+
+    std::vector<GetInventoryItemsWithDescriptionsInfo::RequestType> requests;
+    requests.reserve(pending.size());
+    for (const auto& item : pending)
+    {
+        auto& request=requests.emplace_back();
+        request.set_steamid(steamId.getValue());
+        request.set_language("english");
+        request.set_appid(static_cast<uint32_t>(SteamBot::toInteger(item.itemKey->appId)));
+        request.set_contextid(static_cast<uint32_t>(SteamBot::toInteger(item.itemKey->contextId)));
+        request.set_get_descriptions(true);
+        auto filters=request.mutable_filters();
+        filters->add_assetids(static_cast<uint64_t>(SteamBot::toInteger(item.itemKey->assetId)));
+    }
+
+    auto items=std::move(pending);
+    pending.clear();
+
+    // Process everything we got, then report the first error
+    std::exception_ptr error;
+    auto responses=SteamBot::Modules::UnifiedMessageClient::executeMany<GetInventoryItemsWithDescriptionsInfo::ResultType>("Econ.GetInventoryItemsWithDescriptions#1", std::move(requests));
+    assert(responses.size()==items.size());
+    for (size_t i=0; i<items.size(); i++)
+    {
+        try
         {
-            // ToDo: unfortunately, I don't know how to get more detailed data for "missing_assets".
-            SteamBot::UI::OutputText() << "ignoring an inventory notification because the item is missing";
+            processResponse(items[i], *responses[i].get());
         }
-        else
+        catch(...)
         {
-            assert(false);
+            if (!error) error=std::current_exception();
         }
+    }
+    if (error)
+    {
+        std::rethrow_exception(error);
+    }
+}
+
+/************************************************************************/
+
+void InventoryNotificationModule::processResponse(Pending& item, const GetInventoryItemsWithDescriptionsInfo::ResultType& response)
+{
+    std::shared_ptr<const SteamBot::AssetData::AssetInfo> info;
+    if (response.assets_size()==1)
+    {
+        assert(response.descriptions_size()==1);
 
-        if (info)
+        auto json=SteamBot::toJson(dynamic_cast<const google::protobuf::Message&>(response.descriptions(0)));
+        auto assetKey=std::make_shared<SteamBot::AssetKey>(json);
+        info=SteamBot::AssetData::query(assetKey);
+        if (!info)
         {
-            auto inventoryNotification=std::make_shared<InventoryNotification>(std::move(notification), std::move(itemKey), std::move(info));
-            BOOST_LOG_TRIVIAL(debug) << "InventoryNotification: " << inventoryNotification->toJson();
-            SteamBot::UI::OutputText() << "inventory notification: "
-                                       << SteamBot::enumToStringAlways(inventoryNotification->assetInfo->itemType) << "; "
-                                       << inventoryNotification->assetInfo->type << "; "
-                                       << inventoryNotification->assetInfo->name;
-            client.messageboard.send(std::move(inventoryNotification));
+            info=SteamBot::AssetData::store(json);
+            if (!info)
+            {
+                info=SteamBot::AssetData::query(assetKey);
+            }
         }
     }
+    else if (response.missing_assets_size()==1)
+    {
+        // ToDo: unfortunately, I don't know how to get more detailed data for "missing_assets".
+        SteamBot::UI::OutputText() << "ignoring an inventory notification because the item is missing";
+    }
+    else
+    {
+        assert(false);
+    }
+
+    if (info)
+    {
+        auto inventoryNotification=std::make_shared<InventoryNotification>(std::move(item.notification), std::move(item.itemKey), std::move(info));
+        BOOST_LOG_TRIVIAL(debug) << "InventoryNotification: " << inventoryNotification->toJson();
+        SteamBot::UI::OutputText() << "inventory notification: "
+                                   << SteamBot::enumToStringAlways(inventoryNotification->assetInfo->itemType) << "; "
+                                   << inventoryNotification->assetInfo->type << "; "
+                                   << inventoryNotification->assetInfo->name;
+        SteamBot::Client::getClient().messageboard.send(std::move(inventoryNotification));
+    }
 }
 
 /************************************************************************/
@@ -165,6 +221,7 @@ void InventoryNotificationModule::run(SteamBot::Client&)
     {
         waiter->wait();
         clientNotificationWaiter->handle(this);
+        processPending();
     }
 }
 
@@ -35,8 +35,7 @@
 #include "Login-Session.hpp"
 #include "UI/UI.hpp"
 #include "Client/Signal.hpp"
-
-#include <boost/fiber/protected_fixedsize_stack.hpp>
+#include "FiberStack.hpp"
 
 /************************************************************************/
 
@@ -172,7 +171,7 @@ namespace
             bool quit=false;
             std::queue<std::shared_ptr<CredentialsSession>> fiberQueue;
 
-            auto mainFiber=boost::fibers::fiber(std::allocator_arg, boost::fibers::protected_fixedsize_stack(), [this, &quit, &fiberQueue]() {
+            auto mainFiber=boost::fibers::fiber(std::allocator_arg, SteamBot::FiberStack("Login-Session/main"), [this, &quit, &fiberQueue]() {
                 while (true)
                 {
                     waiter->wait();
@@ -198,7 +197,7 @@ namespace
                 }
             });
 
-            auto commFiber=boost::fibers::fiber(std::allocator_arg, boost::fibers::protected_fixedsize_stack(), [this, &quit, &fiberQueue]() {
+            auto commFiber=boost::fibers::fiber(std::allocator_arg, SteamBot::FiberStack("Login-Session/comm"), [this, &quit, &fiberQueue]() {
                 while (true)
                 {
                     std::unique_lock<decltype(mutex)> lock(mutex);
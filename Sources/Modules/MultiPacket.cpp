@@ -23,9 +23,49 @@
 
 #include "Steam/ProtoBuf/steammessages_base.hpp"
 
-#include <boost/iostreams/device/array.hpp>
-#include <boost/iostreams/filtering_stream.hpp>
-#include <boost/iostreams/filter/gzip.hpp>
+#include <zlib.h>
+
+#include <new>
+#include <vector>
+
+/************************************************************************/
+/*
+ * CMsgMulti payloads are gzip-compressed. We keep one inflate state
+ * per client, and reset it for each message instead of setting up
+ * zlib again; the output buffer is sized from size_unzipped, and
+ * kept around for the next message.
+ */
+
+namespace
+{
+    class Inflater
+    {
+    private:
+        z_stream stream{};
+        std::vector<std::byte> buffer;
+
+    public:
+        Inflater()
+        {
+            // 16 -> expect a gzip header
+            if (inflateInit2(&stream, MAX_WBITS+16)!=Z_OK)
+            {
+                throw std::bad_alloc();
+            }
+        }
+
+        ~Inflater()
+        {
+            inflateEnd(&stream);
+        }
+
+        Inflater(const Inflater&) =delete;
+        Inflater& operator=(const Inflater&) =delete;
+
+    public:
+        std::span<const std::byte> inflate(std::span<const std::byte>, size_t);
+    };
+}
 
 /************************************************************************/
 
@@ -35,6 +75,7 @@ namespace
     {
     private:
         SteamBot::Messageboard::WaiterType<Steam::CMsgMultiMessageType> multiMessageWaiter;
+        Inflater inflater;
 
     public:
         MultiPacketModule() =default;
@@ -57,14 +98,37 @@ static std::span<const std::byte> makePayload(const std::string& string)
 	return std::span<const std::byte>(static_cast<const std::byte*>(static_cast<const void*>(string.data())), string.size());
 }
 
+/************************************************************************/
+/*
+ * Returns an empty span if the data doesn't inflate to exactly
+ * "size" bytes. The result is only valid until the next call.
+ */
+
+std::span<const std::byte> Inflater::inflate(std::span<const std::byte> payload, size_t size)
+{
+    buffer.resize(size);
+
+    inflateReset(&stream);
+    stream.next_in=static_cast<Bytef*>(static_cast<void*>(const_cast<std::byte*>(payload.data())));
+    stream.avail_in=static_cast<uInt>(payload.size());
+    stream.next_out=static_cast<Bytef*>(static_cast<void*>(buffer.data()));
+    stream.avail_out=static_cast<uInt>(buffer.size());
+
+    auto result=::inflate(&stream, Z_FINISH);
+    if (result!=Z_STREAM_END || stream.total_out!=size)
+    {
+        BOOST_LOG_TRIVIAL(error) << "CMsgMulti inflate failed: " << result << " after " << stream.total_out << " of " << size << " bytes";
+        return std::span<const std::byte>();
+    }
+    return std::span<const std::byte>(buffer.data(), size);
+}
+
 /************************************************************************/
 
 void MultiPacketModule::handle(std::shared_ptr<const Steam::CMsgMultiMessageType> message)
 {
     if (message->content.has_message_body())
 	{
-		std::string unzipped;	// we need it as a buffer inside the scope
-
 		auto payload=makePayload(message->content.message_body());
 
 		if (message->content.has_size_unzipped())
@@ -72,16 +136,7 @@ void MultiPacketModule::handle(std::shared_ptr<const Steam::CMsgMultiMessageType
 			auto size=message->content.size_unzipped();
 			if (size>0)
 			{
-				{
-					boost::iostreams::filtering_ostream stream;
-					stream.push(boost::iostreams::gzip_decompressor{});
-					stream.push(boost::iostreams::back_inserter(unzipped));
-                    const char* bytes=static_cast<const char*>(static_cast<const void*>(payload.data()));
-					boost::iostreams::write(stream, bytes, static_cast<std::streamsize>(payload.size()));
-					stream.strict_sync();
-					payload=makePayload(unzipped);
-				}
-				assert(payload.size()==size);
+				payload=inflater.inflate(payload, size);
 			}
 		}
 
@@ -19,6 +19,7 @@
 
 #include "Modules/Connection.hpp"
 #include "Client/Module.hpp"
+#include "Client/Timer.hpp"
 #include "Modules/PlayGames.hpp"
 #include "Modules/OwnedGames.hpp"
 #include "Steam/OSType.hpp"
@@ -351,11 +352,15 @@ void PlayGamesModule::init(SteamBot::Client& client)
 
 void PlayGamesModule::run(SteamBot::Client&)
 {
+    auto timer=SteamBot::Timer::createWaiter(*waiter);
+
     waitForLogin();
 
     while (true)
     {
-        waiter->wait<Clock>(getNextUpdate());
+        timer->setDeadline(getNextUpdate(), std::chrono::seconds(30));
+        waiter->wait();
+        timer->testAndClear();
         playGamesWaiter->handle(this);
         handleUpdates();
     }
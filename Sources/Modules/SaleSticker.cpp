@@ -324,8 +324,9 @@ boost::json::value Status::toJson() const
 
 const Status& SteamBot::SaleSticker::claim()
 {
-    static thread_local boost::fibers::mutex mutex;
-    std::lock_guard<decltype(mutex)> lock(mutex);
+    struct ClaimMutex : public boost::fibers::mutex { };
+    auto& mutex=SteamBot::Client::getClient().getLocal<ClaimMutex>();
+    std::lock_guard<boost::fibers::mutex> lock(mutex);
 
     auto& whiteboard=SteamBot::Client::getClient().whiteboard;
     whiteboard.set<Status>(MyClaim());
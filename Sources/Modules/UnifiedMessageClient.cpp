@@ -19,6 +19,7 @@
 
 #include "Modules/UnifiedMessageClient.hpp"
 #include "Client/Module.hpp"
+#include "Exceptions.hpp"
 #include "Vector.hpp"
 
 #include <boost/log/trivial.hpp>
@@ -95,19 +96,26 @@ std::any UnifiedMessageBase::deserialize(const SteamBot::JobID& jobId, SteamBot:
 
 /************************************************************************/
 
-std::shared_ptr<const ServiceMethodResponseMessage> UnifiedMessageBase::waitForResponse() const
+/*
+ * The response is routed to us by its jobid, so other calls that
+ * are waiting for their responses don't get woken up.
+ */
+
+std::shared_ptr<const ServiceMethodResponseMessage> UnifiedMessageBase::sendAndWait(const std::shared_ptr<SteamBot::Modules::Connection::Messageboard::SendSteamMessage>& sendSteamMessage,
+                                                                                   const SteamBot::Deadline& deadline) const
 {
+    auto& client=SteamBot::Client::getClient();
     auto waiter=SteamBot::Waiter::create();
-    auto cancellation=SteamBot::Client::getClient().cancel.registerObject(*waiter);
+    auto cancellation=client.cancel.registerObject(*waiter);
+
+    auto response=waiter->createWaiter<SteamBot::Modules::Connection::JobWaiter<ServiceMethodResponseMessage>>(jobId);
 
-    std::shared_ptr<SteamBot::Messageboard::Waiter<ServiceMethodResponseMessage>> serviceMethodResponseMessage;
-    serviceMethodResponseMessage=waiter->createWaiter<decltype(serviceMethodResponseMessage)::element_type>(SteamBot::Client::getClient().messageboard);
+    client.messageboard.send(sendSteamMessage);
 
     while (true)
     {
-        waiter->wait();
-        auto message=serviceMethodResponseMessage->fetch();
-        if (message->header.proto.jobid_target()==jobId.getValue())
+        waiter->wait(deadline);
+        if (auto message=response->fetch())
         {
             if (static_cast<SteamBot::ResultCode>(message->header.proto.eresult())!=SteamBot::ResultCode::OK)
             {
@@ -20,6 +20,7 @@
 #include "Modules/Connection.hpp"
 #include "Client/Module.hpp"
 #include "Client/Execute.hpp"
+#include "Client/Timer.hpp"
 #include "Modules/WebSession.hpp"
 #include "Modules/ViewStream.hpp"
 #include "HTMLParser/Parser.hpp"
@@ -211,6 +212,7 @@ bool ViewStream::sendHeartbeat()
     request->queryMaker=[this](){
         static const boost::urls::url_view myUrl("https://steamcommunity.com/broadcast/heartbeat");
         auto query=std::make_unique<SteamBot::HTTPClient::Query>(boost::beast::http::verb::post, myUrl);
+        query->priority=SteamBot::HTTPClient::Query::Priority::TimeSensitive;
 
         std::string body;
         SteamBot::Web::formUrlencode(body, "steamid", this->broadcastSteamId);
@@ -385,10 +387,14 @@ namespace
 
         virtual void run(SteamBot::Client&) override
         {
+            auto timer=SteamBot::Timer::createWaiter(*waiter);
+
             waitForLogin();
             while (true)
             {
-                waiter->wait<Clock>(findNextHeartbeat());
+                timer->setDeadline(findNextHeartbeat(), std::chrono::seconds(1));
+                waiter->wait();
+                timer->testAndClear();
 
                 for (const auto& stream : streams)
                 {
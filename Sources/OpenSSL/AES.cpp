@@ -38,18 +38,18 @@ typedef SteamBot::OpenSSL::AESCrypto AESCrypto;
 
 /************************************************************************/
 
-std::vector<std::byte> AESCrypto::encrypt(const std::span<const std::byte>& bytes) const
+size_t AESCrypto::encrypt(const std::span<const std::byte>& bytes, const std::span<std::byte>& output) const
 {
 	// create a random initialization vector
 	std::array<std::byte, 16> iv;
 	OpenSSL::makeRandomBytes(iv);
 
-	return encryptWithIV(bytes, iv);
+	return encryptWithIV(bytes, iv, output);
 }
 
 /************************************************************************/
 
-std::vector<std::byte> AESCrypto::decrypt(const std::span<const std::byte>& bytes) const
+std::span<std::byte> AESCrypto::decrypt(const std::span<std::byte>& bytes) const
 {
 	std::array<std::byte, 16> iv;
 
@@ -42,57 +42,70 @@
  */
 
 typedef SteamBot::OpenSSL::AESCryptoBase AESCryptoBase;
+typedef SteamBot::OpenSSL::CipherContext CipherContext;
+
+/************************************************************************/
+
+AESCryptoBase::AESCryptoBase(const KeyType& key)
+	: encryptIV(std::make_unique<CipherContext>(CipherContext::getAES256ECB(), true, false, key.data())),
+	  encryptPayload(std::make_unique<CipherContext>(CipherContext::getAES256CBC(), true, true, key.data())),
+	  decryptIV(std::make_unique<CipherContext>(CipherContext::getAES256ECB(), false, false, key.data())),
+	  decryptPayload(std::make_unique<CipherContext>(CipherContext::getAES256CBC(), false, true, key.data()))
+{
+}
+
+/************************************************************************/
+
+AESCryptoBase::~AESCryptoBase() =default;
 
 /************************************************************************/
 /*
  * Encrypt the iv, then encrypt the payload.
  *
+ * The output buffer must have at least getEncryptedSize() bytes.
+ * Returns the number of bytes written.
+ *
  * See SteamKit2, CryptoHelper.cs -> SymmetricEncryptWithIV
  */
 
-std::vector<std::byte> AESCryptoBase::encryptWithIV(const std::span<const std::byte>& bytes, const IvType& iv) const
+size_t AESCryptoBase::encryptWithIV(const std::span<const std::byte>& bytes, const IvType& iv, const std::span<std::byte>& output) const
 {
-	// plaintext size, iv size, padding
-	std::vector<std::byte> output((bytes.size()+iv.size()+16)&~0x0fU);
-	auto outputBuffer=boost::asio::buffer(output);
-
-	static const Encrypt xcrypt;
+	assert(output.size()>=getEncryptedSize(bytes.size()));
+	auto outputBuffer=boost::asio::mutable_buffer(output.data(), output.size());
 
 	// encrypt the iv and output it
-	auto bytesWritten=xcrypt.run(EVP_aes_256_ecb(), false, key.data(), nullptr, boost::asio::buffer(iv), outputBuffer);
+	auto bytesWritten=encryptIV->run(nullptr, boost::asio::buffer(iv), outputBuffer);
 	assert(bytesWritten==iv.size());
 	outputBuffer+=bytesWritten;
 
 	// encrypt the data and output it
-	bytesWritten+=xcrypt.run(EVP_aes_256_cbc(), true, key.data(), iv.data(), makeBuffer(bytes), outputBuffer);
+	bytesWritten+=encryptPayload->run(iv.data(), makeBuffer(bytes), outputBuffer);
 	assert(bytesWritten<=output.size());
-	output.resize(bytesWritten);
 
-	return output;
+	return bytesWritten;
 }
 
 /************************************************************************/
 /*
  * Decrypt the iv, decrypt the payload. Returns both.
  *
+ * The payload is decrypted in place; the returned span is the
+ * plaintext inside the input buffer.
+ *
  * See SteamKit2, CryptoHelper.cs -> SymmetricDecrypt (with the iv param)
  */
 
-std::vector<std::byte> AESCryptoBase::decryptWithIV(const std::span<const std::byte>& bytes, IvType& iv) const
+std::span<std::byte> AESCryptoBase::decryptWithIV(const std::span<std::byte>& bytes, IvType& iv) const
 {
-	std::vector<std::byte> output(bytes.size()-iv.size());
-
-	static const Decrypt xcrypt;
-
 	// get the iv first
 	assert(bytes.size()>=iv.size());
-	auto bytesWritten=xcrypt.run(EVP_aes_256_ecb(), false, key.data(), nullptr, boost::asio::const_buffer(bytes.data(), iv.size()), boost::asio::buffer(iv));
+	auto bytesWritten=decryptIV->run(nullptr, boost::asio::const_buffer(bytes.data(), iv.size()), boost::asio::buffer(iv));
 	assert(bytesWritten==iv.size());
 
 	// followed by the actual payload
-	bytesWritten=xcrypt.run(EVP_aes_256_cbc(), true, key.data(), iv.data(), makeBuffer(bytes.subspan(bytesWritten)), boost::asio::buffer(output));
-	assert(bytesWritten<=output.size());
-	output.resize(bytesWritten);
+	const auto payload=bytes.subspan(bytesWritten);
+	bytesWritten=decryptPayload->run(iv.data(), makeBuffer(payload), boost::asio::mutable_buffer(payload.data(), payload.size()));
+	assert(bytesWritten<=payload.size());
 
-	return output;
+	return payload.first(bytesWritten);
 }
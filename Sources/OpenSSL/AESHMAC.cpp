@@ -119,11 +119,11 @@ void AESCryptoHMAC::makeIV(const std::span<const std::byte>& bytes, IvType& iv)
 
 /************************************************************************/
 
-std::vector<std::byte> AESCryptoHMAC::encrypt(const std::span<const std::byte>& bytes) const
+size_t AESCryptoHMAC::encrypt(const std::span<const std::byte>& bytes, const std::span<std::byte>& output) const
 {
 	IvType iv;
 	makeIV(bytes, iv);
-	return encryptWithIV(bytes, iv);
+	return encryptWithIV(bytes, iv, output);
 }
 
 /************************************************************************/
@@ -145,11 +145,11 @@ bool AESCryptoHMAC::isValidIV(const std::span<const std::byte>& plaintext, const
 
 /************************************************************************/
 
-std::vector<std::byte> AESCryptoHMAC::decrypt(const std::span<const std::byte>& bytes) const
+std::span<std::byte> AESCryptoHMAC::decrypt(const std::span<std::byte>& bytes) const
 {
 	IvType iv;
 	auto plaintext=decryptWithIV(bytes, iv);
-	if (!isValidIV(std::span<const std::byte>(plaintext), iv))
+	if (!isValidIV(plaintext, iv))
 	{
 		throw HMACSHA1MismatchException();
 	}
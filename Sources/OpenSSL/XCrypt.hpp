@@ -22,17 +22,24 @@
 #include "OpenSSL/Exception.hpp"
 
 #include <openssl/evp.h>
+#include <boost/asio/buffer.hpp>
 #include <cassert>
 
 /************************************************************************/
 /*
- * Encrypt/Decrypt the input buffer into the output buffer. Returns
- * the number of bytes written.
+ * Encrypt/Decrypt the input buffer into the output buffer.
  *
- * This performs a full encryption/decryption run -- create context,
- * init with cypher, encrypt/decrypt data, clean up.
+ * A CipherContext is set up once with the cipher and the key; every
+ * run() just resets it to the new IV (if any) and processes the
+ * data. This avoids creating a new EVP_CIPHER_CTX and setting up the
+ * key schedule for every packet.
  *
- * Note: output buffer must be large enough!
+ * The ciphers themselves are fetched once and shared by all
+ * contexts; on OpenSSL 3, the implicit fetch done by EVP_aes_256_xxx()
+ * is expensive.
+ *
+ * Note: output buffer must be large enough! It may be the same as
+ * the input buffer.
  * Returns the number of bytes actually written (this will be slightly
  * larger than the input size if padding is enabled).
  */
@@ -41,59 +48,60 @@ namespace SteamBot
 {
     namespace OpenSSL
     {
-        class Xcrypt
+        class CipherContext
         {
+        private:
+            EVP_CIPHER_CTX* context=nullptr;
+            const bool padding;
+
+        public:
+            static const EVP_CIPHER* getAES256ECB()
+            {
+                static const EVP_CIPHER* const cipher=Exception::throwMaybe(EVP_CIPHER_fetch(nullptr, "AES-256-ECB", nullptr));
+                return cipher;
+            }
+
+            static const EVP_CIPHER* getAES256CBC()
+            {
+                static const EVP_CIPHER* const cipher=Exception::throwMaybe(EVP_CIPHER_fetch(nullptr, "AES-256-CBC", nullptr));
+                return cipher;
+            }
+
         public:
-            virtual int EVP_XcryptInit_ex(EVP_CIPHER_CTX*, const EVP_CIPHER*, ENGINE*, const unsigned char*, const unsigned char*) const =0;
-            virtual int EVP_XcryptUpdate(EVP_CIPHER_CTX*, unsigned char *, int*, const unsigned char*, int) const =0;
-            virtual int EVP_XcryptFinal_ex(EVP_CIPHER_CTX*, unsigned char*, int*) const =0;
+            CipherContext(const EVP_CIPHER* cipher, bool encrypt, bool padding_, const std::byte* key)
+                : padding(padding_)
+            {
+                context=Exception::throwMaybe(EVP_CIPHER_CTX_new());
+                const uint8_t* const keyData=static_cast<const uint8_t*>(static_cast<const void*>(key));
+                Exception::throwMaybe(EVP_CipherInit_ex2(context, cipher, keyData, nullptr, encrypt ? 1 : 0, nullptr));
+            }
+
+            ~CipherContext()
+            {
+                EVP_CIPHER_CTX_free(context);
+            }
+
+            CipherContext(const CipherContext&) =delete;
+            CipherContext& operator=(const CipherContext&) =delete;
 
         public:
-            size_t run(const EVP_CIPHER* cipher, bool padding, const std::byte* key, const std::byte* iv,
-                       const boost::asio::const_buffer& input, const boost::asio::mutable_buffer& output) const
+            size_t run(const std::byte* iv, const boost::asio::const_buffer& input, const boost::asio::mutable_buffer& output)
             {
                 auto outputData=static_cast<uint8_t*>(output.data());
 
-                class EVPCipherContext
-                {
-                private:
-                    EVP_CIPHER_CTX* context;
-
-                public:
-                    EVPCipherContext()
-                    {
-                        Exception::throwMaybe(context=EVP_CIPHER_CTX_new());
-                    }
-
-                    ~EVPCipherContext()
-                    {
-                        if (context!=nullptr)
-                        {
-                            EVP_CIPHER_CTX_free(context);
-                        }
-                    }
-
-                public:
-                    operator decltype(context)() const
-                    {
-                        return context;
-                    }
-                };
-
-                EVPCipherContext context;
+                // keeps the cipher, key and direction
                 {
-                    const uint8_t* const keyData=static_cast<const uint8_t*>(static_cast<const void*>(key));
                     const uint8_t* const ivData=static_cast<const uint8_t*>(static_cast<const void*>(iv));
-                    Exception::throwMaybe(EVP_XcryptInit_ex(context, cipher, nullptr, keyData, ivData));
+                    Exception::throwMaybe(EVP_CipherInit_ex2(context, nullptr, nullptr, ivData, -1, nullptr));
                 }
 
                 EVP_CIPHER_CTX_set_padding(context, padding);
 
                 int bytesWritten=0;
-                Exception::throwMaybe(EVP_XcryptUpdate(context, outputData, &bytesWritten, static_cast<const uint8_t*>(input.data()), static_cast<int>(input.size())));
+                Exception::throwMaybe(EVP_CipherUpdate(context, outputData, &bytesWritten, static_cast<const uint8_t*>(input.data()), static_cast<int>(input.size())));
                 outputData+=bytesWritten;
 
-                Exception::throwMaybe(EVP_XcryptFinal_ex(context, outputData, &bytesWritten));
+                Exception::throwMaybe(EVP_CipherFinal_ex(context, outputData, &bytesWritten));
                 outputData+=bytesWritten;
 
                 bytesWritten=static_cast<int>(outputData-static_cast<uint8_t*>(output.data()));
@@ -101,69 +109,6 @@ namespace SteamBot
 
                 return static_cast<size_t>(bytesWritten);
             }
-
-        public:
-            virtual ~Xcrypt() =default;
-        };
-    }
-}
-
-/************************************************************************/
-
-namespace SteamBot
-{
-    namespace OpenSSL
-    {
-        class Encrypt : public Xcrypt
-        {
-        public:
-            virtual ~Encrypt() =default;
-
-        public:
-            virtual int EVP_XcryptInit_ex(EVP_CIPHER_CTX *ctx, const EVP_CIPHER *type, ENGINE *impl, const unsigned char *key, const unsigned char *iv) const override
-            {
-                return EVP_EncryptInit_ex(ctx, type, impl, key, iv);
-            }
-
-            virtual int EVP_XcryptUpdate(EVP_CIPHER_CTX *ctx, unsigned char *out, int *outl, const unsigned char *in, int inl) const override
-            {
-                return EVP_EncryptUpdate(ctx, out, outl, in, inl);
-            }
-
-            virtual int EVP_XcryptFinal_ex(EVP_CIPHER_CTX *ctx, unsigned char *out, int *outl) const override
-            {
-                return EVP_EncryptFinal_ex(ctx, out, outl);
-            }
-        };
-    }
-}
-
-/************************************************************************/
-
-namespace SteamBot
-{
-    namespace OpenSSL
-    {
-        class Decrypt : public Xcrypt
-        {
-        public:
-            virtual ~Decrypt() =default;
-
-        public:
-            virtual int EVP_XcryptInit_ex(EVP_CIPHER_CTX *ctx, const EVP_CIPHER *type, ENGINE *impl, const unsigned char *key, const unsigned char *iv) const override
-            {
-                return EVP_DecryptInit_ex(ctx, type, impl, key, iv);
-            }
-
-            virtual int EVP_XcryptUpdate(EVP_CIPHER_CTX *ctx, unsigned char *out, int *outl, const unsigned char *in, int inl) const override
-            {
-                return EVP_DecryptUpdate(ctx, out, outl, in, inl);
-            }
-
-            virtual int EVP_XcryptFinal_ex(EVP_CIPHER_CTX *ctx, unsigned char *out, int *outl) const override
-            {
-                return EVP_DecryptFinal_ex(ctx, out, outl);
-            }
         };
     }
 }
@@ -46,6 +46,7 @@ std::shared_ptr<const Response> PostWithSession::execute()
         query->request.body()=std::move(body);
         query->request.content_length(query->request.body().size());
         query->request.base().set("Content-Type", "application/x-www-form-urlencoded");
+        query->priority=priority;
         patchQuery(*query);
         return query;
     };
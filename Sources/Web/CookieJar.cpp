@@ -378,9 +378,11 @@ boost::json::value CookieJar::toJson() const
 
 std::shared_ptr<CookieJar> CookieJar::get()
 {
-    SteamBot::Client::getClient();	// asserts that we are on a client thread
-    static thread_local std::shared_ptr<CookieJar> cookies=std::make_shared<CookieJar>();
-    return cookies;
+    struct Cookies : public std::shared_ptr<CookieJar>
+    {
+        Cookies() : shared_ptr(std::make_shared<CookieJar>()) { }
+    };
+    return SteamBot::Client::getClient().getLocal<Cookies>();
 }
 
 /************************************************************************/